@@ -0,0 +1,117 @@
+/*
+    Copyright (c) 2012 Azriel Fasten azriel.fasten@gmail.com
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef TREE_ADJACENCY_H
+#define TREE_ADJACENCY_H
+
+#include <cstddef>
+
+#include <boost/array.hpp>
+#include <square/square.h>
+
+namespace tree{
+
+/**
+ * Adjacency policies for @c branch_t.
+ * 
+ * A policy decides whether each node keeps links to its neighbors.
+ * @c branch_t derives from the policy's @c links_t, so a policy without
+ * links costs no memory, and @c branch_t::adjacent() does not compile for it;
+ * @c branch_t::find_adjacent() works either way. Define
+ * @c TREE_CHECK_ADJACENCY to assert on every @c adjacent() call that the
+ * link agrees with @c find_adjacent().
+ * 
+ * A policy provides:
+ *      static const bool enabled;
+ *      template<typename branch_type> struct links_t;
+ * and, when @c enabled, @c links_t<branch_type> provides
+ *      branch_type*& adjacent_link(const direction_type& direction);
+ *      branch_type* adjacent_link(const direction_type& direction) const;
+ */
+
+///No neighbor links; neighbors are found by climbing the tree
+struct no_adjacency_t
+{
+  static const bool enabled = false;
+  
+  template<typename branch_type>
+  struct links_t
+  {
+  };
+};
+
+/**
+ * Neighbor links for quadtrees (@c square::corner_t corners).
+ * 
+ * A node links to its neighbor across each edge it shares with its parent:
+ * the node on its own level, or if that was never split down to, the
+ * deepest node covering it; NULL at the edge of the tree. Neighbors across
+ * the other edges are siblings, found through the parent. Lookups are O(1);
+ * a split and a join relink the nodes facing the children along the
+ * parent's edges.
+ */
+struct square_adjacency_t
+{
+  static const bool enabled = true;
+  
+  template<typename branch_type>
+  struct links_t
+  {
+    links_t()
+    {
+      adjacent_links.assign(NULL);
+    }
+    
+    branch_type*& adjacent_link(const square::direction_t& direction)
+    {
+      return adjacent_links[direction.index()];
+    }
+    
+    branch_type* adjacent_link(const square::direction_t& direction) const
+    {
+      return adjacent_links[direction.index()];
+    }
+    
+  private:
+    boost::array<branch_type*, square::direction_t::SIZE> adjacent_links;
+  };
+};
+
+namespace detail{
+
+///Whether a child in @c corner lies along its parent's edge towards @c direction
+inline bool on_side(const square::corner_t& corner, const square::direction_t& direction)
+{
+  if (direction.x() != 0)
+    return corner.x() == (direction.x() > 0);
+  return corner.y() == (direction.y() > 0);
+}
+
+} // namespace detail
+
+} // namespace tree
+
+#endif // TREE_ADJACENCY_H
@@ -0,0 +1,132 @@
+/*
+    Copyright (c) 2012 Azriel Fasten azriel.fasten@gmail.com
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef TREE_ALLOCATOR_H
+#define TREE_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+#include <boost/assert.hpp>
+#include <boost/pool/pool.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+
+namespace tree{
+
+/**
+ * Allocator policies for @c branch_t.
+ * 
+ * A policy hands out the raw storage for a brood: all the children of one
+ * node, side by side in one block. @c root_t holds the policy by value and
+ * every branch reaches it through its root, so a policy with state worth
+ * sharing between trees should share it between its copies.
+ * 
+ * A policy provides:
+ *      void* allocate(std::size_t bytes);
+ *      void deallocate(void* storage, std::size_t bytes);
+ */
+
+///Takes every brood from the free store
+struct heap_allocator_t
+{
+  void* allocate(std::size_t bytes)
+  {
+    return ::operator new(bytes);
+  }
+  
+  void deallocate(void* storage, std::size_t)
+  {
+    ::operator delete(storage);
+  }
+};
+
+/**
+ * Takes broods from a pool of equally sized blocks, shared by all copies of
+ * the allocator: freeing a brood is O(1), and a brood freed by a join in one
+ * tree is reused by the next split in any tree sharing the pool.
+ * 
+ * The block size is set by the first allocation. Not thread safe.
+ */
+struct pool_allocator_t
+{
+  ///@param blocks_per_chunk blocks the pool grows by the first time; it doubles after that
+  explicit pool_allocator_t(std::size_t blocks_per_chunk = 64)
+    : mstate(boost::make_shared<state_t>(blocks_per_chunk))
+  {}
+  
+  void* allocate(std::size_t bytes)
+  {
+    if (!mstate->pool)
+      mstate->pool.reset(new boost::pool<>(bytes, mstate->blocks_per_chunk));
+    
+    BOOST_ASSERT(bytes == mstate->pool->get_requested_size());
+    
+    void* storage = mstate->pool->malloc();
+    if (!storage)
+      throw std::bad_alloc();
+    
+    ++mstate->used;
+    return storage;
+  }
+  
+  void deallocate(void* storage, std::size_t bytes)
+  {
+    BOOST_ASSERT(!!mstate->pool);
+    BOOST_ASSERT(bytes == mstate->pool->get_requested_size());
+    BOOST_ASSERT(mstate->used > 0);
+    (void)bytes;
+    
+    mstate->pool->free(storage);
+    --mstate->used;
+  }
+  
+  ///Broods currently handed out
+  std::size_t used() const
+  {
+    return mstate->used;
+  }
+  
+private:
+  struct state_t
+  {
+    explicit state_t(std::size_t blocks_per_chunk)
+      : blocks_per_chunk(blocks_per_chunk)
+      , used(0)
+    {}
+    
+    std::size_t blocks_per_chunk;
+    std::size_t used;
+    boost::scoped_ptr< boost::pool<> > pool;
+  };
+  
+  boost::shared_ptr<state_t> mstate;
+};
+
+} // namespace tree
+
+#endif // TREE_ALLOCATOR_H
@@ -0,0 +1,189 @@
+/*
+    Copyright (c) 2012 Azriel Fasten azriel.fasten@gmail.com
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef TREE_FIELDS_H
+#define TREE_FIELDS_H
+
+#include <cstddef>
+#include <limits>
+
+#include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
+
+namespace tree{
+
+/**
+ * Field policies for @c branch_t.
+ * 
+ * Besides its value, its parent and its children, a node has a level, a
+ * root and a corner in its parent. Each of these is either stored in the
+ * node, or derived from the parent links when asked for, trading time for
+ * memory; @c node_fields_t picks one policy for each.
+ * 
+ * A field policy provides:
+ *      static const bool stored;
+ *      template<typename root_type, typename corner_type> struct field_t;
+ * where @c field_t is constructed from (root_type& root, std::size_t level, const corner_type& corner)
+ * and, when @c stored, has the field's getter. A policy that is not stored
+ * has an empty @c field_t, and @c branch_t derives the field itself.
+ */
+
+///The level is kept in a byte; levels go up to 255
+struct stored_level_t
+{
+  static const bool stored = true;
+  
+  template<typename root_type, typename corner_type>
+  struct field_t
+  {
+    field_t(root_type&, std::size_t level, const corner_type&)
+      : mlevel(boost::uint8_t(level))
+    {
+      BOOST_ASSERT(level <= std::numeric_limits<boost::uint8_t>::max());
+    }
+    
+    std::size_t level() const
+    {
+      return mlevel;
+    }
+    
+  private:
+    boost::uint8_t mlevel;
+  };
+};
+
+///The level is counted by climbing to the root; O(level)
+struct climbing_level_t
+{
+  static const bool stored = false;
+  
+  template<typename root_type, typename corner_type>
+  struct field_t
+  {
+    field_t(root_type&, std::size_t, const corner_type&) {}
+  };
+};
+
+///Each node points at its root
+struct stored_root_t
+{
+  static const bool stored = true;
+  
+  template<typename root_type, typename corner_type>
+  struct field_t
+  {
+    field_t(root_type& root, std::size_t, const corner_type&)
+      : mroot(&root)
+    {}
+    
+    root_type& root() const
+    {
+      return *mroot;
+    }
+    
+  private:
+    root_type* mroot;
+  };
+};
+
+///The root is found by climbing to it; O(level)
+struct climbing_root_t
+{
+  static const bool stored = false;
+  
+  template<typename root_type, typename corner_type>
+  struct field_t
+  {
+    field_t(root_type&, std::size_t, const corner_type&) {}
+  };
+};
+
+///The corner's index is kept in a byte
+struct stored_corner_t
+{
+  static const bool stored = true;
+  
+  template<typename root_type, typename corner_type>
+  struct field_t
+  {
+    field_t(root_type&, std::size_t, const corner_type& corner)
+      : mcorner(corner.index())
+    {}
+    
+    const corner_type& corner() const
+    {
+      return corner_type::get(mcorner);
+    }
+    
+  private:
+    boost::uint8_t mcorner;
+  };
+};
+
+///The corner is the node's position in its parent's brood; O(1)
+struct implicit_corner_t
+{
+  static const bool stored = false;
+  
+  template<typename root_type, typename corner_type>
+  struct field_t
+  {
+    field_t(root_type&, std::size_t, const corner_type&) {}
+  };
+};
+
+/**
+ * One policy per field, for @c branch_t; by default everything is stored.
+ * 
+ * The fields are kept together, largest first, so a node packs the ones it
+ * stores next to its value.
+ */
+template<typename level_policy_t = stored_level_t,
+         typename root_policy_t = stored_root_t,
+         typename corner_policy_t = stored_corner_t>
+struct node_fields_t
+{
+  typedef level_policy_t level_policy;
+  typedef root_policy_t root_policy;
+  typedef corner_policy_t corner_policy;
+  
+  template<typename root_type, typename corner_type>
+  struct storage_t
+    : root_policy_t::template field_t<root_type, corner_type>
+    , level_policy_t::template field_t<root_type, corner_type>
+    , corner_policy_t::template field_t<root_type, corner_type>
+  {
+    storage_t(root_type& root, std::size_t level, const corner_type& corner)
+      : root_policy_t::template field_t<root_type, corner_type>(root, level, corner)
+      , level_policy_t::template field_t<root_type, corner_type>(root, level, corner)
+      , corner_policy_t::template field_t<root_type, corner_type>(root, level, corner)
+    {}
+  };
+};
+
+} // namespace tree
+
+#endif // TREE_FIELDS_H
@@ -0,0 +1,269 @@
+/*
+    Copyright (c) 2012 Azriel Fasten azriel.fasten@gmail.com
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef TREE_TRAVERSAL_H
+#define TREE_TRAVERSAL_H
+
+#include <cstddef>
+
+#include <boost/assert.hpp>
+#include <boost/range.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/type_traits/is_convertible.hpp>
+#include <boost/utility/enable_if.hpp>
+
+namespace tree{
+
+namespace detail{
+
+///The node after @c node in its brood; NULL for the last child
+template<typename cv_branch_type>
+inline cv_branch_type* next_sibling(cv_branch_type& node)
+{
+  cv_branch_type* parent = node.parent();
+  BOOST_ASSERT(parent);
+  
+  ///A brood is one array, in corner index order
+  cv_branch_type* next = &node + 1;
+  return next != boost::end(parent->children()) ? next : NULL;
+}
+
+///The first child of the first child ... of @c node, down to a leaf
+template<typename cv_branch_type>
+inline cv_branch_type* leftmost_leaf(cv_branch_type* node, std::size_t& depth)
+{
+  while (node->has_children())
+  {
+    node = &*boost::begin(node->children());
+    ++depth;
+  }
+  
+  return node;
+}
+
+///Climb from @c node to the first ancestor-or-self with a next sibling, and return that sibling; NULL at @c root
+template<typename cv_branch_type>
+inline cv_branch_type* climb_to_next(cv_branch_type* root, cv_branch_type* node, std::size_t& depth)
+{
+  while (node != root)
+  {
+    if (cv_branch_type* sibling = next_sibling(*node))
+      return sibling;
+    
+    node = node->parent();
+    --depth;
+  }
+  
+  return NULL;
+}
+
+/**
+ * Orders for @c traversal_iterator. Each moves @c current to the first
+ * node of the subtree under @c root, or to the node after @c current;
+ * NULL when there is none. @c depth follows @c current, relative to @c root.
+ */
+
+///Parents before their children
+struct pre_order_t
+{
+  template<typename cv_branch_type>
+  static void first(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t)
+  {
+    current = root;
+    depth = 0;
+  }
+  
+  template<typename cv_branch_type>
+  static void next(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t)
+  {
+    if (current->has_children())
+    {
+      current = &*boost::begin(current->children());
+      ++depth;
+    } else {
+      current = climb_to_next(root, current, depth);
+    }
+  }
+};
+
+///Children before their parents; moving on never looks below the current node, so it may be split or joined
+struct post_order_t
+{
+  template<typename cv_branch_type>
+  static void first(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t)
+  {
+    depth = 0;
+    current = leftmost_leaf(root, depth);
+  }
+  
+  template<typename cv_branch_type>
+  static void next(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t)
+  {
+    if (current == root)
+    {
+      current = NULL;
+    } else if (cv_branch_type* sibling = next_sibling(*current)) {
+      current = leftmost_leaf(sibling, depth);
+    } else {
+      current = current->parent();
+      --depth;
+    }
+  }
+};
+
+///Only the leaves, in pre-order
+struct leaf_order_t
+{
+  template<typename cv_branch_type>
+  static void first(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t)
+  {
+    depth = 0;
+    current = leftmost_leaf(root, depth);
+  }
+  
+  template<typename cv_branch_type>
+  static void next(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t)
+  {
+    current = climb_to_next(root, current, depth);
+    
+    if (current)
+      current = leftmost_leaf(current, depth);
+  }
+};
+
+///Only the nodes @c target levels below the root, in pre-order; nothing below them is visited
+struct level_order_t
+{
+  template<typename cv_branch_type>
+  static void first(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t target)
+  {
+    current = root;
+    depth = 0;
+    
+    if (target != 0)
+      next(root, current, depth, target);
+  }
+  
+  template<typename cv_branch_type>
+  static void next(cv_branch_type* root, cv_branch_type*& current, std::size_t& depth, std::size_t target)
+  {
+    do
+    {
+      if (depth < target && current->has_children())
+      {
+        current = &*boost::begin(current->children());
+        ++depth;
+      } else {
+        current = climb_to_next(root, current, depth);
+      }
+    } while (current && depth != target);
+  }
+};
+
+/**
+ * Forward iterator over a subtree, in the order of @c order_t.
+ * 
+ * Holds the subtree's root, the current node and its depth, and nothing
+ * else: it walks the parent links and the broods, so it takes O(1) memory
+ * and an increment takes amortized O(1) time (O(depth) at worst, climbing
+ * out of a deep branch).
+ */
+template<typename cv_branch_type, typename order_t>
+struct traversal_iterator
+  : public boost::iterator_facade<traversal_iterator<cv_branch_type, order_t>,
+                                  cv_branch_type,
+                                  boost::forward_traversal_tag>
+{
+private:
+  struct enabler {};  // a private type avoids misuse
+public:
+  ///The end of any traversal
+  traversal_iterator()
+    : root(NULL), current(NULL), depth(0), target(0)
+  {}
+  
+  ///The first node under @c root; @c target is the depth a @c level_order_t traversal stays at
+  traversal_iterator(cv_branch_type& root, std::size_t target)
+    : root(&root), current(NULL), depth(0), target(target)
+  {
+    order_t::first(this->root, current, depth, target);
+  }
+  
+  template <class other_branch_type>
+  traversal_iterator(
+      traversal_iterator<other_branch_type, order_t> const& other
+                        ///This parameter is ignored; its just here to make sure that @c other is convertable to this
+                      , typename boost::enable_if<
+                              boost::is_convertible<other_branch_type*,cv_branch_type*>
+                          , enabler
+                        >::type = enabler()
+    )
+    : root(other.root), current(other.current), depth(other.depth), target(other.target)
+  {}
+  
+  ///Levels below the traversal's root the current node is
+  std::size_t relative_level() const
+  {
+    BOOST_ASSERT(current);
+    return depth;
+  }
+  
+private:
+  template <class, class>
+  friend struct traversal_iterator;
+  
+  friend class boost::iterator_core_access;
+  
+  void increment()
+  {
+    BOOST_ASSERT(current);
+    order_t::next(root, current, depth, target);
+  }
+  
+  cv_branch_type& dereference() const
+  {
+    BOOST_ASSERT(current);
+    return *current;
+  }
+  
+  template <class other_branch_type>
+  bool equal(const traversal_iterator<other_branch_type, order_t>& other) const
+  {
+    ///Every finished traversal is the same end iterator
+    return current == other.current;
+  }
+  
+  cv_branch_type* root;
+  cv_branch_type* current;
+  std::size_t depth;
+  std::size_t target;
+};
+
+} // namespace detail
+
+} // namespace tree
+
+#endif // TREE_TRAVERSAL_H
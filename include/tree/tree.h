@@ -27,7 +27,10 @@
 #ifndef TREE_TREE_H
 #define TREE_TREE_H
 
-#include <boost/iterator/indirect_iterator.hpp>
+#include "tree/allocator.h"
+#include "tree/adjacency.h"
+#include "tree/fields.h"
+#include "tree/traversal.h"
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/ref.hpp>
@@ -38,271 +41,25 @@
 #include <boost/noncopyable.hpp>
 #include <boost/array.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/mpl/bool.hpp>
+
+#include <vector>
 
 //#include "tree/face_traverser.h"
 
 
 namespace tree{
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t = heap_allocator_t,
+         typename adjacency_t = no_adjacency_t, typename fields_t = node_fields_t<> >
 struct root_t;
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t = heap_allocator_t,
+         typename adjacency_t = no_adjacency_t, typename fields_t = node_fields_t<> >
 struct branch_t;
 
 
 
-namespace detail{
-
-
-#if 0
-
-template<typename value_type, typename traverser_type>
-struct  dual_pointer_traversal_iterator
-  : public boost::iterator_facade<dual_pointer_traversal_iterator<value_type, traverser_type>,
-                                  value_type,
-                                  boost::forward_traversal_tag>
-{
-  BOOST_CONCEPT_ASSERT((Traverser<traverser_type, value_type>));
-private:
-  struct enabler {};  // a private type avoids misuse
-public:
-  dual_pointer_traversal_iterator()
-    : root(), current(), last()
-  {
-    BOOST_ASSERT(!valid());
-  }
-  
-  dual_pointer_traversal_iterator(const traverser_type& root, bool end)
-    : root(root), current(root), last(root)
-  {
-    if (end)
-      current.reset();
-    
-    BOOST_ASSERT(valid());
-  }
-  
-
-  template <class OtherValue, class OtherTraverser>
-  dual_pointer_traversal_iterator(
-      dual_pointer_traversal_iterator<OtherValue, OtherTraverser> const& other
-      
-                        ///This parameter is ignored; its just here to make sure that @c other is convertable to this
-                      , typename boost::enable_if<
-                              boost::is_convertible<OtherValue*,value_type*>
-                          , enabler
-                        >::type = enabler()
-    )
-    : root(other.root), current(other.current), last(other.last)
-  {
-    BOOST_ASSERT(other.valid());
-    BOOST_ASSERT(valid());
-    
-  }
-
-  template<typename T>
-  dual_pointer_traversal_iterator& operator=(const T& other)
-  {
-    assign(other);
-    return *this;
-  }
-
-private:
-  
-  template <class, class>
-  friend class dual_pointer_traversal_iterator;
-  
-  friend class boost::iterator_core_access;
-  
-  void increment() {
-    BOOST_ASSERT(valid());
-    BOOST_ASSERT(dereferencable());
-    
-    traverser_type old_current = current;
-    {
-      ///TODO think through what happens when root is actually the root of the tree and it has no children
-      
-      // up/right traversal loop
-      while(true){
-        if (on_my_way_down())
-        {
-          BOOST_ASSERT(current.is_child_of(last));
-          BOOST_ASSERT(current != root);
-          
-          if (current.has_children())
-          {
-            last = current;
-            current = current.first_child();
-            break;
-          } else if (!current.is_last_sibling()){
-            BOOST_ASSERT(!current.has_children());
-            
-            last = current;
-            current = current.next_sibling();
-            break;
-          } else {
-            BOOST_ASSERT(!current.has_children());
-            BOOST_ASSERT(current.is_last_sibling());
-            last = current;
-            current = current.parent();
-            
-            BOOST_ASSERT(on_my_way_up());
-            continue;
-          }
-          
-        } else if (on_my_way_up()) {
-          if (current == root)
-          {
-            last = current;
-            current.reset();
-            
-            break;
-          } else if(!current.is_last_sibling() ) {
-            BOOST_ASSERT(current != root);
-            BOOST_ASSERT(!current.is_last_sibling());
-            last = current;
-            current = current.next_sibling();
-            break;
-          } else {
-            last = current;
-            current = current.parent();
-            BOOST_ASSERT(on_my_way_up());
-            continue;
-          }
-        } // on_my_way_up()
-        else
-        { // !on_my_way_up(), !on_my_way_down
-          BOOST_ASSERT(!on_my_way_down() && !on_my_way_down());
-        
-          if (current == root)
-          {
-            BOOST_ASSERT(last == current);
-            
-            if ( current.has_children() )
-            {
-              last = current;
-              current = current.first_child();
-              break;
-            } else {
-              last = current;
-              current.reset();
-              break;
-            }
-          }
-          else 
-          {
-            
-            BOOST_ASSERT(last.parent() == current.parent());
-            BOOST_ASSERT(!last.is_last_sibling());
-            BOOST_ASSERT(last.next_sibling() == current);
-            
-            if (current.has_children())
-            {
-              last = current;
-              current = current.first_child();
-              BOOST_ASSERT(on_my_way_down());
-              break;
-            } else if (!current.is_last_sibling()){
-              last = current;
-              current = current.next_sibling();
-              
-              BOOST_ASSERT(!on_my_way_down() && !on_my_way_up());
-              break;
-            } else {
-              last = current;
-              current = current.parent();
-              BOOST_ASSERT(on_my_way_up());
-              continue;
-            }
-          }
-        }
-        BOOST_ASSERT(false && "Something is wrong");
-      } // up/right traversal loop
-    }
-    
-    BOOST_ASSERT(current != old_current);
-    BOOST_ASSERT(valid());
-    BOOST_ASSERT(!on_my_way_up());
-    BOOST_ASSERT(on_my_way_down() || !on_my_way_up());
-  }
-  
-  value_type& dereference() const {
-    BOOST_ASSERT(valid());
-    BOOST_ASSERT(dereferencable());
-    return *current;
-  }
-  
-  template<typename T>
-  bool equal(const T& other) const
-  {
-    return equal_internal(other);
-  }
-  
-private:
-  bool valid() const{
-    ///TODO: triple check this
-    return root.valid() && last.valid();
-  }
-  
-  bool dereferencable() const{
-    ///TODO: triple check this
-    
-    return valid() && current.valid();
-  }
-  
-  template <class OtherValue, class OtherTraverser>
-  void
-  assign(dual_pointer_traversal_iterator<OtherValue, OtherTraverser> const& other,
-                ///This parameter is ignored; its just here to make sure that @c other is convertable to this
-                typename boost::enable_if<
-                      boost::is_convertible<OtherValue*,value_type*>
-                  , enabler
-                >::type = enabler() )
-  {
-    BOOST_ASSERT(other.valid());
-    bool other_is_derefable = other.dereferencable();
-    
-    ///TODO: double check this is all members before giving green light
-    this->root = other.root;
-    this->current = other.current;
-    this->last = other.last;
-    
-    BOOST_ASSERT(valid());
-    BOOST_ASSERT(liff(other_is_derefable, dereferencable()));
-  }
-  
-  template <class OtherValue, class OtherTraverser>
-  bool equal_internal(dual_pointer_traversal_iterator<OtherValue, OtherTraverser> const& other,
-                ///This parameter is ignored; its just here to make sure that @c other is convertable to this
-                typename boost::enable_if<
-                      boost::is_convertible<OtherValue*,value_type*>
-                  , enabler
-                >::type = enabler()
-    ) const
-  {
-    return (this->root == other.root) && (this->current == other.current) && (this->last == other.last);
-  }
-  
-  
-  
-  bool on_my_way_down() const{
-    BOOST_ASSERT(valid());
-    return current.is_child_of(last);
-  }
-  
-  bool on_my_way_up() const{
-    BOOST_ASSERT(valid());
-    return last.is_child_of(current);
-  }
-  
-  traverser_type root;
-  traverser_type current;
-  traverser_type last;
-};
-
-#endif
-
-} // namespace detail
 
 
 
@@ -314,7 +71,7 @@ private:
  *                                                      O(1)/O(1)/O(1) increment time,
  *                                                      O(depth of tree) memory
  *                      
- *                      dual pointer based
+ *                      dual pointer based (parent links, see tree/traversal.h; what the traversal ranges use)
  *                              (best/average/worst/[amortized constant]):
  *                                                      O(n)/O(n)/O(n) traversal,
  *                                                      O(1)/O(1)/O(depth of tree)/O(1) increment time
@@ -328,11 +85,11 @@ private:
  * node-counter
  * ordered-face traverser
  *      clockwise vs counter clockwise
- * leaf-to-root traverser
+ * leaf-to-root traverser (done, post_order_traversal())
  *      leaf-first traverser so one can modify the nodes
  * leaf-to-root face-traverser
- * leaf-traverser
- * level-traverser
+ * leaf-traverser (done, leaf_traversal())
+ * level-traverser (done for exactly that level, level_traversal())
  *      Traversal of all nodes on a level (or closest possible to that level)
  * octree-web
  *      A web of linked non-overlapping nodes on different levels that define some depth of an octree.
@@ -340,7 +97,6 @@ private:
  * back-to-front traversal
  * back-to-front traversal of a web
  * 
- * destruct iteratively leaf-to-root otherwise stack might not like the destructor recursion
  * 
  * scaffolding to search the tree
  * some sort of bounded-box info:
@@ -359,7 +115,7 @@ private:
  * 
  * mixouts
  *      make these separate optional mixins:
- *              ~ adjacency policy
+ *              ~ adjacency policy (done, see tree/adjacency.h)
  *                      nodes should keep track of their adjacent facing out-of-parent neighbors
  *              ~ parent policy
  *                      nodes should know their parent
@@ -369,7 +125,7 @@ private:
  *                      ~ using the parent, keeping track of node's child id, finding the other children
  *                      ~ keeping neihbor links
  *                      ~ implicitly in a constant depth tree
- *              ~ root policy
+ *              ~ root policy (done, see tree/fields.h)
  *                      how nodes can find the root
  *                      methods:
  *                              ~ keep a pointer to the root, obtained upon creation
@@ -384,7 +140,7 @@ private:
  *                      methods:
  *                              ~ the node traverses the tree counting the nodes, an O(n) worst case operation to count
  *                              ~ each node keeps a count of their desendents, insertion and deletion would now cost >= O(depth of tree) worst case
- *              ~ level policy
+ *              ~ level policy (done, see tree/fields.h)
  *                      each node keeps track of its level
  *                      methods:
  *                              ~ each node keeps its own level, consequently requires storing an extra integer, obtained upon creation,
@@ -410,26 +166,42 @@ private:
  *                      make use of cube::corner_t a policy that decides how many children each node has (make it no longer an octree but an N?-tree)
  */
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 struct branch_t
   : private boost::noncopyable
+  , private adjacency_t::template links_t< branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t> >
 {
 public:
-  typedef root_t<T, CHILDREN, corner_t> root_type;
+  typedef root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t> root_type;
   
-  typedef branch_t<T, CHILDREN, corner_t> self_type;
+  typedef branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t> self_type;
   typedef self_type child_type;
   typedef self_type adjacent_type;
   typedef std::pair<adjacent_type*, adjacent_type*> adjacent_link;
   
-  typedef boost::array<boost::scoped_ptr<child_type>, CHILDREN> children_type;
-  typedef boost::indirect_iterator< typename children_type::iterator > child_iterator;
-  typedef boost::indirect_iterator< typename children_type::const_iterator > const_child_iterator;
+  typedef allocator_t allocator_type;
+  typedef adjacency_t adjacency_type;
+  typedef fields_t fields_type;
+  typedef typename corner_t::direction_type direction_type;
+  typedef typename adjacency_t::template links_t<self_type> links_type;
+  
+  ///Children are stored as one contiguous brood, in corner index order
+  typedef child_type* child_iterator;
+  typedef const child_type* const_child_iterator;
   
   //typedef detail::dual_pointer_traversal_iterator<branch_t, face_traverser<branch_t, corner_t, face_t> > face_iterator;
   //typedef detail::dual_pointer_traversal_iterator<const branch_t, face_traverser<const branch_t, corner_t, face_t> > const_face_iterator;
-  //typedef detail::dual_pointer_traversal_iterator<branch_t, corner_traverser<branch_t> > traversal_iterator;
-  //typedef detail::dual_pointer_traversal_iterator<const branch_t, corner_traverser<const branch_t> > const_traversal_iterator;
+  
+  ///Traversals of the subtree under a node; see tree/traversal.h
+  typedef detail::traversal_iterator<self_type, detail::pre_order_t> pre_order_iterator;
+  typedef detail::traversal_iterator<const self_type, detail::pre_order_t> const_pre_order_iterator;
+  typedef detail::traversal_iterator<self_type, detail::post_order_t> post_order_iterator;
+  typedef detail::traversal_iterator<const self_type, detail::post_order_t> const_post_order_iterator;
+  typedef detail::traversal_iterator<self_type, detail::leaf_order_t> leaf_iterator;
+  typedef detail::traversal_iterator<const self_type, detail::leaf_order_t> const_leaf_iterator;
+  typedef detail::traversal_iterator<self_type, detail::level_order_t> level_iterator;
+  typedef detail::traversal_iterator<const self_type, detail::level_order_t> const_level_iterator;
   
   typedef T value_type;
   
@@ -443,20 +215,64 @@ public:
   boost::iterator_range< const_child_iterator > children() const;
   
   
-  //boost::iterator_range< traversal_iterator > traversal();
-  //boost::iterator_range< const_traversal_iterator > traversal() const;
+  /**
+   * This node and its descendants, parents before their children. Like the
+   * other traversals, it follows the parent links: O(1) memory and amortized
+   * O(1) increments. The tree must not change while it is traversed.
+   */
+  boost::iterator_range< pre_order_iterator > pre_order_traversal();
+  boost::iterator_range< const_pre_order_iterator > pre_order_traversal() const;
+  
+  ///This node and its descendants, children before their parents; the current node may be split or joined
+  boost::iterator_range< post_order_iterator > post_order_traversal();
+  boost::iterator_range< const_post_order_iterator > post_order_traversal() const;
+  
+  ///The leaves under this node (or itself, if a leaf), in pre-order
+  boost::iterator_range< leaf_iterator > leaf_traversal();
+  boost::iterator_range< const_leaf_iterator > leaf_traversal() const;
+  
+  ///The nodes under this node (or itself) at @c level, in pre-order; nothing deeper is visited
+  boost::iterator_range< level_iterator > level_traversal(std::size_t level);
+  boost::iterator_range< const_level_iterator > level_traversal(std::size_t level) const;
   
   
   
   
   void split();
+  ///Destroy the subtree below this node, iteratively
   void join();
   
+  /**
+   * Unhook the children from this node without destroying them; this node
+   * becomes a leaf, and neighbors linked into the subtree link to it instead
+   * (see @c adjacency_t). The returned brood (NULL for a leaf) must be handed to
+   * @c release_brood(), before the root goes away.
+   */
+  child_type* detach();
+  
+  /**
+   * Destroy a detached @c brood, after detaching its children's broods and
+   * appending them to @c pending; never recurses. @c allocator is the
+   * tree's, or a copy of it sharing its state: the brood may no longer be
+   * able to find its root.
+   */
+  static void release_brood(child_type* brood, allocator_type& allocator, std::vector<child_type*>& pending);
+  
   child_type& child(const corner_t& corner);
   const child_type& child(const corner_t& corner) const;
   
-  //adjacent_type* adjacent(const cube::direction_t& direction);
-  //const adjacent_type* adjacent(const cube::direction_t& direction) const;
+  /**
+   * The neighbor across @c direction on this node's level or, if the tree
+   * was not split that far there, the deepest node covering it; NULL at the
+   * edge of the tree. O(1); only for an @c adjacency_t with links, e.g.
+   * @c square_adjacency_t.
+   */
+  adjacent_type* adjacent(const direction_type& direction);
+  const adjacent_type* adjacent(const direction_type& direction) const;
+  
+  ///The same node as @c adjacent(), found by climbing to the common ancestor and back down; O(level), needs no links
+  adjacent_type* find_adjacent(const direction_type& direction);
+  const adjacent_type* find_adjacent(const direction_type& direction) const;
   
   //boost::iterator_range< face_iterator > face_traversal(const square::face_t& face);
   //boost::iterator_range< const_face_iterator > face_traversal(const square::face_t& face) const;
@@ -496,49 +312,66 @@ private:
   //No slicing
   branch_t(const root_type&);
   
-  root_type& mroot;
   self_type* mparent;
+  ///First of the @c CHILDREN children, taken from the root's allocator; NULL for a leaf
+  child_type* mchildren;
   T mvalue;
-  std::size_t mlevel;
-  corner_t mcorner;
+  ///Level, root and corner, as far as @c fields_t stores them
+  typename fields_t::template storage_t<root_type, corner_t> mfields;
   
 private:
-#if 0
-  void set_adjacent_link(const cube::direction_t& direction, adjacent_type* adjacent_node);
-  adjacent_type* get_adjacent_link(const cube::direction_t& direction);
-  const adjacent_type* get_adjacent_link(const cube::direction_t& direction) const;
   template<typename cv_tree_type>
-  static cv_tree_type* get_adjacent_link(cv_tree_type& tree_node, const cube::direction_t& direction);
-  
-  ///This code was getting to complicated to duplicate for const and non-const functions
+  static cv_tree_type* adjacent(cv_tree_type& from_node, const direction_type& direction);
   template<typename cv_tree_type>
-  static
-  cv_tree_type*
-  adjacent(cv_tree_type& from_node, const cube::direction_t& direction);
+  static cv_tree_type* find_adjacent(cv_tree_type& from_node, const direction_type& direction);
   
-  boost::array<adjacent_type*, 6> adjacent_links;
+  ///Link the new children to their neighbors, and the neighbors' nodes facing them back
+  void initialize_adjacencies(boost::mpl::true_);
+  void initialize_adjacencies(boost::mpl::false_) {}
   
-  void initialize_adjacencies();
+  ///Link the nodes facing the children, about to go away, to this node instead
+  void uninitialize_adjacencies(boost::mpl::true_);
+  void uninitialize_adjacencies(boost::mpl::false_) {}
   
-  void uninitialize_adjacencies();
-#endif
+  ///Link @c node, and its descendants along its edge towards @c direction, to @c adjacent_node
+  static void relink_edge(self_type& node, const direction_type& direction, adjacent_type* adjacent_node);
 private:
-  boost::scoped_ptr< children_type > mchildren;
+  ///Bytes of a brood of children
+  static std::size_t brood_size();
+  
+  //field getters, for fields stored (true_) or derived (false_)
+  
+  std::size_t level(boost::mpl::true_) const;
+  std::size_t level(boost::mpl::false_) const;
+  const root_type& root(boost::mpl::true_) const;
+  const root_type& root(boost::mpl::false_) const;
+  const corner_t& corner(boost::mpl::true_) const;
+  const corner_t& corner(boost::mpl::false_) const;
 };
 
 
 
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 struct root_t
-  : public branch_t<T, CHILDREN, corner_t>
+  : public branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>
 {
-  typedef branch_t<T, CHILDREN, corner_t> super;
+  typedef branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t> super;
+  typedef allocator_t allocator_type;
+  typedef adjacency_t adjacency_type;
   
   root_t(T value);
+  root_t(T value, const allocator_type& allocator);
   root_t();
+  ~root_t();
+  
+  ///Where every brood of this tree comes from
+  allocator_type& allocator();
   
+private:
+  allocator_type mallocator;
 };
 
 
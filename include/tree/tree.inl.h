@@ -30,208 +30,73 @@
 #include <boost/assert.hpp>
 #include <boost/foreach.hpp>
 
+#include <new>
+
 
 namespace tree{
   
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-root_t<T, CHILDREN, corner_t>::
+root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 root_t(T value)
   : super(*this, NULL, value, 0, corner_t::get(0))
+  , mallocator()
 {
 
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-root_t<T, CHILDREN, corner_t>::
-root_t()
-  : super(*this, NULL, T(), 0, corner_t::get(0))
+root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+root_t(T value, const allocator_type& allocator)
+  : super(*this, NULL, value, 0, corner_t::get(0))
+  , mallocator(allocator)
 {
 
 }
 
-
-
-#if 0
-
-template<typename T>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-void
-branch_t<T>::
-initialize_adjacencies()
-{
-  //TODO: make sure this adjacency thingy works for the root
-  //TODO: make sure this adjacency thingy works in destruction too
-  //TODO: optimize adjacency in destruction of parent with lots of children
-  //TODO: make sure the destructor iteratively destroys its children, bottom up
-  ///@note don't use any member functions here, some things haven't finished initializing yet
-  ///@note don't depend on parent knowing its children yet; and we cannot yet know our siblings either
-  /// as we are being just now created and haven't yet been inserted into our parents
-  
-  BOOST_FOREACH(const cube::face_t& face, corner().faces())
-  {
-    set_adjacent_link(face.direction(), NULL);
-  }
-  
-  if (!mparent)
-    return;
-  
-  
-  
-  ///For each adjacent node (possibly non-existent),
-  BOOST_FOREACH(const cube::face_t& face, mcorner.faces())
-  {
-    const cube::direction_t& adjacent_direction = face.direction();
-    
-    
-    
-    /*
-    ///Link me to adjacent node or closest parent of adjacent node
-    branch_t* adjacent_node_parent_closest_ptr = NULL;
-    if (mparent->corner().face_set().contains(face))
-    {
-      adjacent_node_parent_closest_ptr = mparent->adjacent(adjacent_direction);
-      
-      ///If parent has no adjacent, we are at the edge of the tree, and we don't either
-      if (!adjacent_node_parent_closest_ptr)
-        continue;
-    } else if(mparent->is_child()) {
-      const cube::corner_t& parent_corner = mparent->corner();
-      const cube::corner_t& ungle_corner = parent_corner.adjacent(adjacent_direction);
-      
-      adjacent_node_parent_closest_ptr = &(mparent->mparent->child(ungle_corner));
-    } else {
-      ///We are close to the root, and thus the edge, no adjacency
-      continue;
-    }
-    */
-    
-    branch_t* adjacent_node_parent_closest_ptr = mparent->adjacent(adjacent_direction);
-    
-    if (!adjacent_node_parent_closest_ptr)
-    {
-      ///We are close to the root, or the edge, and have no adjacency
-      continue;
-    }
-    
-    BOOST_ASSERT(!!adjacent_node_parent_closest_ptr);
-    
-    branch_t& adjacent_node_parent_closest = *adjacent_node_parent_closest_ptr;
-    
-    ///My parent's adjacent node in this direction is at least as low as my parent's level
-    BOOST_ASSERT(adjacent_node_parent_closest.level() <= mparent->level());
-    
-    ///My parent's adjacent node in this direction is definitely lower than my level
-    BOOST_ASSERT(adjacent_node_parent_closest.level() < level());
-    
-    
-    bool adjacent_node_parent_closest_has_children = adjacent_node_parent_closest.has_children();
-    bool parent_links_same = (adjacent_node_parent_closest.level() == level() - 1);
-    bool parent_links_lower = (adjacent_node_parent_closest.level() < level() - 1);
-    
-    ///If my parent's adjacent link is not on my parent's level
-    ///Then my parent's adjacent doesn't have children (otherwise my parent would point to them)
-    BOOST_ASSERT( lif(!parent_links_same, adjacent_node_parent_closest_has_children) );
-    ///Same as above, just sanity testing
-    BOOST_ASSERT( lif(parent_links_lower, adjacent_node_parent_closest_has_children) );
-    
-    ///If my parent's adjacent link has children,
-    ///Then my parent must be on the same level as it, otherwise my parent would point lower to its children.
-    BOOST_ASSERT( lif(adjacent_node_parent_closest_has_children, parent_links_same) );
-    
-    if (!adjacent_node_parent_closest_has_children)
-    {
-      ///If the parent adjacent has no children
-      
-      ///Link to the parent adjacent
-      set_adjacent_link(adjacent_direction, &adjacent_node_parent_closest);
-      
-    } // !adjacent_node_parent_closest_has_children
-    else
-    { // adjacent_node_parent_closest_has_children
-      ///If the parent adjacent has children
-      
-      ///If my parent's adjacent link has children,
-      ///Then my parent must be on the same level as it, otherwise my parent would point lower to its children.
+root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+root_t()
+  : super(*this, NULL, T(), 0, corner_t::get(0))
+  , mallocator()
+{
 
-      BOOST_ASSERT(parent_links_same);
-      
-      ///If there is an existing node on my level, that is adjacent to me
-      
-      
-      const cube::corner_t& facing_adjacent_corner = corner().adjacent(adjacent_direction.opposite());
-      
-      ///TODO
-      branch_t& adjacent_node = adjacent_node_parent_closest.child(facing_adjacent_corner);
-      
-      ///Set this node as facing @c adjacent_node
-      set_adjacent_link(adjacent_direction, &adjacent_node);
-      
-      ///Adjacent node should be linked to my parent
-      BOOST_ASSERT((adjacent_node.adjacent(adjacent_direction.opposite())) == mparent);
-      
-      ///Adjacent node might have children, those facing me would be linked to my parent
-      ///They should be relinked to me
-      
-      BOOST_FOREACH(branch_t& facing_node, adjacent_node.face_traversal(adjacent_direction.opposite().face()))
-      {
-      ///For each facing node that is inside of the node adjacent to me (includes the adjacent node itself)
-        
-        ///The facing node would have been facing my parent
-        ///Therefore if my parent is NULL, it should think that *it's* adjacent neighbor in *my* direction
-        /// is NULL.
-        ///If my parent is not NULL. it should think that *it's* adjacent neighbor in *my* direction
-        /// is my parent
-        BOOST_ASSERT(
-            (mparent == NULL && facing_node.adjacent(adjacent_direction.opposite()) == NULL)
-          || (facing_node.adjacent(adjacent_direction.opposite()) == mparent));
-        
-        ///Inform the facing node of it's new adjacent neighbor, *me*
-        facing_node.set_adjacent_link(adjacent_direction.opposite(), this);
-      }
-      
-    } // adjacent_node_parent_closest_has_children
-  } // foreach adjacent face to this corner
-  
 }
-template<typename T>
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-void
-branch_t<T>::
-uninitialize_adjacencies()
+root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+~root_t()
 {
-  if (!mparent)
-    return;
-  ///TODO
-  
+  ///The broods go back to @c mallocator, so they must go before it does
+  super::join();
 }
 
-
-
-
-
-
-template<typename T>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-void
-branch_t<T>::
-set_adjacent_link(const cube::direction_t& direction, adjacent_type* adjacent_node)
+typename root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::allocator_type&
+root_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+allocator()
 {
-  BOOST_ASSERT((direction.index() < adjacent_links.size()) && "Invalid direction");
-  
-  BOOST_ASSERT(corner().face_set().contains(direction.face()) && "Adjacent links do not include siblings");
-  
-  adjacent_links[direction.index()] = adjacent_node;
+  return mallocator;
 }
 
-#endif
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 branch_t(root_type& root, branch_t* parent, T value, std::size_t level, const corner_t& corner)
-  : mroot(root), mparent(parent), mvalue(value), mlevel(level), mcorner(corner), mchildren()
+  : mparent(parent), mchildren(NULL), mvalue(value), mfields(root, level, corner)
 {
   ///FIXME: re-enable this when face iterator is working again
   ///Make sure our iterator is convertable to const_iterator
@@ -242,9 +107,10 @@ branch_t(root_type& root, branch_t* parent, T value, std::size_t level, const co
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 ~branch_t()
 {
   join();
@@ -255,151 +121,320 @@ branch_t<T, CHILDREN, corner_t>::
 
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::const_child_iterator >
-branch_t<T, CHILDREN, corner_t>::
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_child_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 children() const
 {
-  if (mchildren)
-  {
-    return boost::make_iterator_range(const_child_iterator(mchildren->begin()), const_child_iterator(mchildren->end()));
-  }
-  
-  return boost::make_iterator_range(const_child_iterator(), const_child_iterator());
+  ///A leaf gives an empty range, [NULL, NULL)
+  return boost::make_iterator_range(const_child_iterator(mchildren),
+                                    const_child_iterator(mchildren ? mchildren + CHILDREN : NULL));
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::child_iterator >
-branch_t<T, CHILDREN, corner_t>::
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::child_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 children()
 {
-  if (mchildren)
-  {
-    return boost::make_iterator_range(child_iterator(mchildren->begin()), child_iterator(mchildren->end()));
-  }
-  
-  return boost::make_iterator_range(child_iterator(), child_iterator());
+  ///A leaf gives an empty range, [NULL, NULL)
+  return boost::make_iterator_range(child_iterator(mchildren),
+                                    child_iterator(mchildren ? mchildren + CHILDREN : NULL));
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 T&
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 value()
 {
   return mvalue;
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 const T&
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 value() const
 {
   return mvalue;
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
-const typename branch_t<T, CHILDREN, corner_t>::root_type&
-branch_t<T, CHILDREN, corner_t>::
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+const typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::root_type&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 root() const
 {
-  return mroot;
+  return root(boost::mpl::bool_<fields_t::root_policy::stored>());
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
-typename branch_t<T, CHILDREN, corner_t>::root_type&
-branch_t<T, CHILDREN, corner_t>::
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::root_type&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 root()
 {
-  return mroot;
+  ///A non-const node's root is non-const too
+  return const_cast<root_type&>(static_cast<const self_type&>(*this).root());
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 void
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 split()
 {
   if (!mchildren)
   {
-    mchildren.reset( new children_type() );
+    allocator_t& allocator = root().allocator();
     
-    BOOST_FOREACH(const corner_t& c, corner_t::all())
+    child_type* brood = static_cast<child_type*>(allocator.allocate(brood_size()));
+    std::size_t constructed = 0;
+    
+    try
     {
-      boost::scoped_ptr<child_type>& child_ptr = (*mchildren)[c.index()];
-      child_ptr.reset( new child_type(root(), this, T(), mlevel + 1, c) );
-      
-      BOOST_ASSERT(!child_ptr->is_root());
-      BOOST_ASSERT(child_ptr->is_child());
-      BOOST_ASSERT(this->is_parent_of(*child_ptr));
-      BOOST_ASSERT(child_ptr->is_child_of(*this));
+      BOOST_FOREACH(const corner_t& c, corner_t::all())
+      {
+        BOOST_ASSERT(c.index() == constructed);
+        new (brood + constructed) child_type(root(), this, T(), level() + 1, c);
+        ++constructed;
+      }
+    }
+    catch (...)
+    {
+      while (constructed > 0)
+        brood[--constructed].~child_type();
+      allocator.deallocate(brood, brood_size());
+      throw;
+    }
+    
+    BOOST_ASSERT(constructed == CHILDREN);
+    mchildren = brood;
+    
+    initialize_adjacencies(boost::mpl::bool_<adjacency_t::enabled>());
+    
+#ifndef NDEBUG
+    BOOST_FOREACH(const child_type& child, children())
+    {
+      BOOST_ASSERT(!child.is_root());
+      BOOST_ASSERT(child.is_child());
+      BOOST_ASSERT(this->is_parent_of(child));
+      BOOST_ASSERT(child.is_child_of(*this));
     }
-   
+#endif
   }
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 void
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 join()
 {
-  ///FIXME: this will make a recursive destructor call all the way down the tree,
-  ///we should do this with a receding-depth-first traversal to destroy the highest levels of the tree first iteratively
-  mchildren.reset();
+  if (!mchildren)
+    return;
+  
+  allocator_type& allocator = root().allocator();
+  std::vector<child_type*> pending(1, detach());
+  
+  while (!pending.empty())
+  {
+    child_type* brood = pending.back();
+    pending.pop_back();
+    
+    release_brood(brood, allocator, pending);
+  }
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::child_type*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+detach()
+{
+  if (mchildren)
+    uninitialize_adjacencies(boost::mpl::bool_<adjacency_t::enabled>());
+  
+  child_type* brood = mchildren;
+  mchildren = NULL;
+  return brood;
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+void
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+release_brood(child_type* brood, allocator_type& allocator, std::vector<child_type*>& pending)
+{
+  BOOST_ASSERT(brood);
+  
+  ///Not detach(): the neighbors outside were relinked when the brood's parent let go of it, and may be gone by now
+  for (std::size_t i = 0; i < CHILDREN; ++i)
+  {
+    if (brood[i].mchildren)
+    {
+      pending.push_back(brood[i].mchildren);
+      brood[i].mchildren = NULL;
+    }
+  }
+  
+  ///They are all leaves now, so their destructors stop right there
+  for (std::size_t i = CHILDREN; i > 0; --i)
+    brood[i - 1].~child_type();
+  
+  ///The whole brood goes back in one piece
+  allocator.deallocate(brood, brood_size());
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+std::size_t
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+brood_size()
+{
+  return sizeof(child_type) * CHILDREN;
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 const corner_t&
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 corner() const
 {
-  return mcorner;
+  return corner(boost::mpl::bool_<fields_t::corner_policy::stored>());
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-typename branch_t<T, CHILDREN, corner_t>::child_type&
-branch_t<T, CHILDREN, corner_t>::
+typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::child_type&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 child(const corner_t& corner)
 {
   BOOST_ASSERT(mchildren);
-  return *(*mchildren)[corner.index()];
+  return mchildren[corner.index()];
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-const typename branch_t<T, CHILDREN, corner_t>::child_type&
-branch_t<T, CHILDREN, corner_t>::
+const typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::child_type&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 child(const corner_t& corner) const
 {
   BOOST_ASSERT(mchildren);
-  return *(*mchildren)[corner.index()];
+  return mchildren[corner.index()];
 }
 
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 std::size_t
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 level() const
 {
-  return mlevel;
+  return level(boost::mpl::bool_<fields_t::level_policy::stored>());
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+std::size_t
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+level(boost::mpl::true_) const
+{
+  return mfields.level();
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+std::size_t
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+level(boost::mpl::false_) const
+{
+  std::size_t result = 0;
+  
+  for (const self_type* ancestor = mparent; ancestor; ancestor = ancestor->mparent)
+    ++result;
+  
+  return result;
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+const typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::root_type&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+root(boost::mpl::true_) const
+{
+  return mfields.root();
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+const typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::root_type&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+root(boost::mpl::false_) const
+{
+  const self_type* ancestor = this;
+  
+  while (ancestor->mparent)
+    ancestor = ancestor->mparent;
+  
+  ///Only a root_t has no parent
+  return static_cast<const root_type&>(*ancestor);
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+const corner_t&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+corner(boost::mpl::true_) const
+{
+  return mfields.corner();
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+const corner_t&
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+corner(boost::mpl::false_) const
+{
+  ///Children are stored in corner index order
+  if (!mparent)
+    return corner_t::get(boost::uint8_t(0));
+  
+  BOOST_ASSERT(mparent->mchildren);
+  return corner_t::get(boost::uint8_t(this - mparent->mchildren));
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-branch_t<T, CHILDREN, corner_t>*
-branch_t<T, CHILDREN, corner_t>::parent()
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::parent()
 {
   if (mparent) {
     BOOST_ASSERT(mparent != this);
@@ -410,10 +445,11 @@ branch_t<T, CHILDREN, corner_t>::parent()
   return mparent;
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-const branch_t<T, CHILDREN, corner_t>*
-branch_t<T, CHILDREN, corner_t>::
+const branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 parent() const
 {
   if (mparent) {
@@ -426,153 +462,290 @@ parent() const
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 bool
-branch_t<T, CHILDREN, corner_t>::is_root() const
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::is_root() const
 {
-  return &mroot == this;
+  return !mparent;
 }
 
-#if 0
-template<typename T>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 template<typename cv_tree_type>
+inline
 cv_tree_type*
-branch_t<T>::
-get_adjacent_link(cv_tree_type& from_node, const cube::direction_t& direction)
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+adjacent(cv_tree_type& from_node, const direction_type& direction)
 {
+  BOOST_STATIC_ASSERT(adjacency_t::enabled);
   
-  BOOST_ASSERT(direction.index() < from_node.adjacent_links.size());
+  if (!from_node.mparent)
+    return NULL;
   
-  if (from_node.mcorner.face_set().contains(direction.face()))
-    return from_node.adjacent_links[direction.index()];
+  cv_tree_type* result = detail::on_side(from_node.corner(), direction)
+                       ? from_node.links_type::adjacent_link(direction)
+                       : &from_node.mparent->child(from_node.corner().adjacent(direction));
   
-  if (from_node.mparent)
-  {
-    const cube::corner_t& sibling_corner = from_node.mcorner.adjacent(direction);
-    return &(from_node.mparent->child(sibling_corner));
-  }
-  return NULL;
+  ///I only point to nodes that are on my level, or lower
+  BOOST_ASSERT(!result || result->level() <= from_node.level());
+  
+#ifdef TREE_CHECK_ADJACENCY
+  ///Climbing costs more than the links save, so the cross-check is opt-in
+  BOOST_ASSERT(result == find_adjacent(from_node, direction));
+#endif
+  
+  return result;
 }
 
-template<typename T>
-typename branch_t<T>::adjacent_type*
-branch_t<T>::
-get_adjacent_link(const cube::direction_t& direction)
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::adjacent_type*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+adjacent(const direction_type& direction)
 {
-  return get_adjacent_link(*this, direction);
+  return adjacent(*this, direction);
 }
 
-template<typename T>
-const typename branch_t<T>::adjacent_type*
-branch_t<T>::
-get_adjacent_link(const cube::direction_t& direction) const
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+const typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::adjacent_type*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+adjacent(const direction_type& direction) const
 {
-  return get_adjacent_link(*this, direction);
+  return adjacent(*this, direction);
 }
 
-
-template<typename T>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 template<typename cv_tree_type>
 inline
 cv_tree_type*
-branch_t<T>::
-adjacent(cv_tree_type& from_node, const cube::direction_t& direction)
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+find_adjacent(cv_tree_type& from_node, const direction_type& direction)
 {
-  cv_tree_type* result = from_node.get_adjacent_link(direction);
-  if (!result)
-    return result;
+  if (!from_node.mparent)
+    return NULL;
   
-  ///I only point to nodes that are on my level, or lower
-  BOOST_ASSERT(result->level() <= from_node.level());
+  ///Across an edge inside the parent lies a sibling
+  if (!detail::on_side(from_node.corner(), direction))
+    return &from_node.mparent->child(from_node.corner().adjacent(direction));
   
-  ///If I am adjacent to a node, they must be adjacent to *a* node in the opposite direction
-  /// (a sibling of it's, me, or one of my ancestors) FIXME:
-  //BOOST_ASSERT(!!result->adjacent(direction.opposite()));
+  ///Otherwise it is a child of the parent's neighbor, mirrored across the edge, if that was split
+  cv_tree_type* parent_adjacent = find_adjacent(*from_node.mparent, direction);
   
-#ifndef NDEBUG
-  ///Find my ancestor that is on the same level as my adjacent node
-  cv_tree_type* reverse_adjacent_ancestor_or_self = &from_node;
+  if (!parent_adjacent || !parent_adjacent->has_children())
+    return parent_adjacent;
+  
+  return &parent_adjacent->child(from_node.corner().adjacent(direction));
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::adjacent_type*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+find_adjacent(const direction_type& direction)
+{
+  return find_adjacent(*this, direction);
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+const typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::adjacent_type*
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+find_adjacent(const direction_type& direction) const
+{
+  return find_adjacent(*this, direction);
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+void
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+initialize_adjacencies(boost::mpl::true_)
+{
+  BOOST_ASSERT(mchildren);
   
-  ///Sanity
-  BOOST_ASSERT(reverse_adjacent_ancestor_or_self);
+  BOOST_FOREACH(child_type& child, children())
   {
-    for (std::size_t i = 0; i < from_node.level() - result->level(); ++i)
+    BOOST_FOREACH(const direction_type& direction, direction_type::all())
     {
-      BOOST_ASSERT(reverse_adjacent_ancestor_or_self->is_child());
-      BOOST_ASSERT(reverse_adjacent_ancestor_or_self->mparent);
-      reverse_adjacent_ancestor_or_self = reverse_adjacent_ancestor_or_self->mparent;
-      BOOST_ASSERT(reverse_adjacent_ancestor_or_self);
+      ///Siblings are found through the parent
+      if (!detail::on_side(child.corner(), direction))
+        continue;
+      
+      adjacent_type* parent_adjacent = adjacent(direction);
+      
+      ///A neighbor coarser than me is a leaf, or I would point lower, to its children
+      BOOST_ASSERT(!parent_adjacent || parent_adjacent->level() == level() || !parent_adjacent->has_children());
+      
+      if (!parent_adjacent || !parent_adjacent->has_children())
+      {
+        child.links_type::adjacent_link(direction) = parent_adjacent;
+        continue;
+      }
+      
+      adjacent_type& child_adjacent = parent_adjacent->child(child.corner().adjacent(direction));
+      child.links_type::adjacent_link(direction) = &child_adjacent;
+      
+      ///It, and its descendants along the edge it shares with the child, pointed at me until now
+      BOOST_ASSERT(child_adjacent.links_type::adjacent_link(direction.opposite()) == this);
+      relink_edge(child_adjacent, direction.opposite(), &child);
     }
   }
-  
-  ///My ancestor, on the same level as *my* "adjacent node", should be the "adjacent node" of *my* "adjacent node"
-  ///FIXME:this is recursion ...
-  //BOOST_ASSERT(reverse_adjacent_ancestor_or_self == result->adjacent(direction.opposite()));
-#endif
-  
-  return result;
 }
 
-template<typename T>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-typename branch_t<T>::adjacent_type*
-branch_t<T>::
-adjacent(const cube::direction_t& direction)
+void
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+uninitialize_adjacencies(boost::mpl::true_)
 {
-  return adjacent(*this, direction);
+  BOOST_ASSERT(mchildren);
+  
+  BOOST_FOREACH(child_type& child, children())
+  {
+    BOOST_FOREACH(const direction_type& direction, direction_type::all())
+    {
+      if (!detail::on_side(child.corner(), direction))
+        continue;
+      
+      adjacent_type* child_adjacent = child.links_type::adjacent_link(direction);
+      
+      ///Only a neighbor on the child's level has nodes pointing into this subtree
+      if (child_adjacent && child_adjacent->level() == child.level())
+        relink_edge(*child_adjacent, direction.opposite(), this);
+    }
+  }
 }
 
-template<typename T>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-const typename branch_t<T>::adjacent_type*
-branch_t<T>::
-adjacent(const cube::direction_t& direction) const
+void
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+relink_edge(self_type& node, const direction_type& direction, adjacent_type* adjacent_node)
 {
-  return adjacent(*this, direction);
+  node.links_type::adjacent_link(direction) = adjacent_node;
+  
+  BOOST_FOREACH(child_type& child, node.children())
+  {
+    if (detail::on_side(child.corner(), direction))
+      relink_edge(child, direction, adjacent_node);
+  }
 }
 
-#endif
-
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 bool 
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 has_children() const
 {
   return !!mchildren;
 }
 
-/*
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_pre_order_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+pre_order_traversal() const
+{
+  return boost::make_iterator_range(const_pre_order_iterator(*this, 0), const_pre_order_iterator());
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::pre_order_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+pre_order_traversal()
+{
+  return boost::make_iterator_range(pre_order_iterator(*this, 0), pre_order_iterator());
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::const_traversal_iterator >
-branch_t<T, CHILDREN, corner_t>::
-traversal() const
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_post_order_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+post_order_traversal() const
 {
-  typedef corner_traverser<const branch_t> traverser_t;
-  traverser_t me(this);
-  return boost::make_iterator_range( const_traversal_iterator(me, false),
-                              const_traversal_iterator(me, true) );
+  return boost::make_iterator_range(const_post_order_iterator(*this, 0), const_post_order_iterator());
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::traversal_iterator >
-branch_t<T, CHILDREN, corner_t>::
-traversal()
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::post_order_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+post_order_traversal()
 {
-  typedef corner_traverser<branch_t> traverser_t;
-  traverser_t me(this);
-  return boost::make_iterator_range( traversal_iterator(me, false),
-                              traversal_iterator(me, true) );
+  return boost::make_iterator_range(post_order_iterator(*this, 0), post_order_iterator());
 }
 
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_leaf_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+leaf_traversal() const
+{
+  return boost::make_iterator_range(const_leaf_iterator(*this, 0), const_leaf_iterator());
+}
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::leaf_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+leaf_traversal()
+{
+  return boost::make_iterator_range(leaf_iterator(*this, 0), leaf_iterator());
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_level_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+level_traversal(std::size_t level) const
+{
+  ///Nothing under this node is that shallow
+  if (level < this->level())
+    return boost::make_iterator_range(const_level_iterator(), const_level_iterator());
+  
+  return boost::make_iterator_range(const_level_iterator(*this, level - this->level()), const_level_iterator());
+}
+
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
+inline
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::level_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+level_traversal(std::size_t level)
+{
+  ///Nothing under this node is that shallow
+  if (level < this->level())
+    return boost::make_iterator_range(level_iterator(), level_iterator());
+  
+  return boost::make_iterator_range(level_iterator(*this, level - this->level()), level_iterator());
+}
+
+/*
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::face_iterator >
-branch_t<T, CHILDREN, corner_t>::
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::face_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 face_traversal(const cube::face_t& face)
 {
   typedef face_traverser<branch_t> traverser_t;
@@ -581,10 +754,11 @@ face_traversal(const cube::face_t& face)
                               face_iterator(me, true) );
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::const_face_iterator >
-branch_t<T, CHILDREN, corner_t>::
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_face_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 face_traversal(const cube::face_t& face) const
 {
   typedef face_traverser<const branch_t> traverser_t;
@@ -593,45 +767,49 @@ face_traversal(const cube::face_t& face) const
                               const_face_iterator(me, true) );
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
-boost::iterator_range< typename branch_t<T, CHILDREN, corner_t>::const_face_iterator >
-branch_t<T, CHILDREN, corner_t>::
+boost::iterator_range< typename branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::const_face_iterator >
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 cface_traversal(const cube::face_t& face) const
 {
   return face_traversal(face);
 }
 */
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 bool
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 is_child() const
 {
   return !!mparent;
 }
 
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 bool
-branch_t<T, CHILDREN, corner_t>::
-is_child_of(const branch_t<T, CHILDREN, corner_t>& other) const
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
+is_child_of(const branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>& other) const
 {
   if (!!mparent && (mparent == &other))
   {
     BOOST_ASSERT(other.mchildren);
-    BOOST_ASSERT(&*(*other.mchildren)[corner().index()] == this);
+    BOOST_ASSERT(&other.mchildren[corner().index()] == this);
     return true;
   }
   return false;
 }
 
-template<typename T, std::size_t CHILDREN, typename corner_t>
+template<typename T, std::size_t CHILDREN, typename corner_t, typename allocator_t, typename adjacency_t,
+         typename fields_t>
 inline
 bool
-branch_t<T, CHILDREN, corner_t>::
+branch_t<T, CHILDREN, corner_t, allocator_t, adjacency_t, fields_t>::
 is_parent_of(const self_type& other) const
 {
   if ( !!other.mparent && (other.mparent == this) )
@@ -639,8 +817,7 @@ is_parent_of(const self_type& other) const
     BOOST_ASSERT(has_children());
     BOOST_ASSERT(other.is_child());
     BOOST_ASSERT(!!mchildren);
-    BOOST_ASSERT(!!(*mchildren)[other.corner().index()]);
-    BOOST_ASSERT(&*(*mchildren)[other.corner().index()] == &other);
+    BOOST_ASSERT(&mchildren[other.corner().index()] == &other);
     return true;
   }
   return false;
@@ -45,7 +45,7 @@ void MordredApplication::createScene()
   
   Real radius = 6353;
   AxisAlignedBox bounds(Vector3(-radius,-radius,-radius), Vector3(radius,radius,radius));
-  std::size_t max_levels = 33;
+  std::size_t max_levels = 31;
   mCamera->setFarClipDistance(0);
   mCamera->setPosition(radius + 500,radius + 500,radius + 500);
   
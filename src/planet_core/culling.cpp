@@ -0,0 +1,119 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "culling.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace planet_core
+{
+
+containment_t classify(const frustum_t& frustum, const oriented_box_t& box, plane_mask_t& mask)
+{
+  for (std::size_t i = 0; i < frustum_t::PLANE_COUNT; ++i)
+  {
+    plane_mask_t bit = plane_mask_t(1) << i;
+    
+    if (!(mask & bit))
+      continue;
+    
+    const plane_t& plane = frustum.planes[i];
+    
+    ///The box's extent along the plane's normal
+    vector3_t local_normal = box.axes * plane.normal;
+    real_t reach = std::fabs(local_normal.x) * box.half_extents.x
+                 + std::fabs(local_normal.y) * box.half_extents.y
+                 + std::fabs(local_normal.z) * box.half_extents.z;
+    
+    real_t distance = plane.signed_distance(box.center);
+    
+    if (distance < -reach)
+      return OUTSIDE;
+    
+    if (distance >= reach)
+      mask &= ~bit;
+  }
+  
+  return mask ? INTERSECTING : INSIDE;
+}
+
+bool back_facing(const normal_cone_t& cone, const vector3_t& center, real_t radius, const vector3_t& camera_position)
+{
+  static const real_t half_pi = real_t(1.57079632679489661923);
+  
+  vector3_t to_camera = camera_position - center;
+  real_t distance = to_camera.length();
+  
+  if (distance <= radius)
+    return false;
+  
+  ///Seen from anywhere in the sphere, the camera is within this angle of the direction to it from the center
+  real_t spread = std::asin(radius / distance);
+  
+  real_t cosine = cone.axis.dot(to_camera / distance);
+  real_t angle = std::acos(std::max(real_t(-1), std::min(real_t(1), cosine)));
+  
+  return angle > half_pi + cone.angle + spread;
+}
+
+horizon_t::horizon_t(const vector3_t& camera_position, real_t occluder_radius)
+  : camera_direction(camera_position.normalised())
+  , occluder_radius(occluder_radius)
+  , camera_horizon(0)
+  , outside(camera_position.length() > occluder_radius)
+{
+  if (outside)
+    camera_horizon = horizon_angle(camera_position.length());
+}
+
+real_t horizon_t::camera_angle(const vector3_t& direction) const
+{
+  ///From the chord, which keeps small angles that acos of the dot product would round away
+  return real_t(2) * std::asin(std::min(real_t(1), direction.distance(camera_direction) / real_t(2)));
+}
+
+real_t horizon_t::horizon_angle(real_t point_radius) const
+{
+  return point_radius > occluder_radius ? std::acos(occluder_radius / point_radius) : real_t(0);
+}
+
+bool horizon_t::hides(const vector3_t& direction, real_t angular_radius, real_t top_radius) const
+{
+  if (!outside)
+    return false;
+  
+  return camera_angle(direction) - angular_radius > camera_horizon + horizon_angle(top_radius);
+}
+
+bool horizon_t::reveals(const vector3_t& direction, real_t angular_radius, real_t bottom_radius) const
+{
+  if (!outside)
+    return true;
+  
+  return camera_angle(direction) + angular_radius <= camera_horizon + horizon_angle(bottom_radius);
+}
+
+} // namespace planet_core
@@ -0,0 +1,144 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PLANET_CORE_CULLING_H
+#define PLANET_CORE_CULLING_H
+
+#include "types.h"
+#include "planet_geometry.h"
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+namespace planet_core
+{
+
+///Points @c p with @c normal.dot(p) + @c distance >= 0 are inside the plane
+struct plane_t
+{
+  plane_t()
+    : normal()
+    , distance(0)
+  {}
+  
+  plane_t(const vector3_t& normal, real_t distance)
+    : normal(normal)
+    , distance(distance)
+  {}
+  
+  real_t signed_distance(const vector3_t& point) const
+  {
+    return normal.dot(point) + distance;
+  }
+  
+  ///Unit length
+  vector3_t normal;
+  real_t distance;
+};
+
+///Set of planes a volume still has to be tested against; bit i is plane i
+typedef boost::uint8_t plane_mask_t;
+
+///The camera's view volume, planet relative; its planes face inward
+struct frustum_t
+{
+  static const std::size_t PLANE_COUNT = 6;
+  static const plane_mask_t ALL_PLANES = (1 << PLANE_COUNT) - 1;
+  
+  frustum_t()
+    : planes()
+    , active(ALL_PLANES)
+  {}
+  
+  boost::array<plane_t, PLANE_COUNT> planes;
+  ///Planes to test at all, e.g. without the far plane of an infinite projection
+  plane_mask_t active;
+};
+
+enum containment_t
+{
+  OUTSIDE,
+  INTERSECTING,
+  INSIDE
+};
+
+/**
+ * Classify @c box against the planes of @c frustum in @c mask.
+ * 
+ * Planes the box is wholly inside of are cleared from @c mask: everything
+ * within the box is inside them too, so nested volumes need not test them
+ * again. With an empty @c mask the box is @c INSIDE without any test.
+ */
+containment_t classify(const frustum_t& frustum, const oriented_box_t& box, plane_mask_t& mask);
+
+/**
+ * Whether every triangle with a normal within @c cone, anywhere within the
+ * sphere of @c radius around @c center, faces away from @c camera_position.
+ */
+bool back_facing(const normal_cone_t& cone, const vector3_t& center, real_t radius, const vector3_t& camera_position);
+
+/**
+ * The planet's horizon seen from a camera: a sphere no terrain dips below
+ * occludes whatever is far enough around it.
+ * 
+ * A point at distance @c r from the planet's center is visible over the
+ * sphere when its angle from the camera, seen from the center, is at most
+ * acos(occluder / camera distance) + acos(occluder / @c r).
+ */
+struct horizon_t
+{
+  ///@param occluder_radius no terrain is lower than this, planet relative
+  horizon_t(const vector3_t& camera_position, real_t occluder_radius);
+  
+  /**
+   * Whether every point within @c angular_radius around @c direction, no
+   * higher than @c top_radius, is below the horizon.
+   */
+  bool hides(const vector3_t& direction, real_t angular_radius, real_t top_radius) const;
+  
+  /**
+   * Whether every point within @c angular_radius around @c direction, no
+   * lower than @c bottom_radius, is above the horizon; always true with the
+   * camera inside the occluder, which then hides nothing.
+   */
+  bool reveals(const vector3_t& direction, real_t angular_radius, real_t bottom_radius) const;
+  
+private:
+  ///Angle of @c direction from the camera's, seen from the center
+  real_t camera_angle(const vector3_t& direction) const;
+  ///Angle from the center between a point at @c point_radius and the horizon it sees
+  real_t horizon_angle(real_t point_radius) const;
+  
+  vector3_t camera_direction;
+  real_t occluder_radius;
+  ///The camera's own horizon angle
+  real_t camera_horizon;
+  ///The camera is outside the occluder
+  bool outside;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_CULLING_H
@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+ * Whether the LOD cut settles for a still camera, at the renderer's
+ * tolerances (4 pixels to split, 2 to merge) and depth: for random
+ * cameras, from just above the drawn surface (below the terrain's peaks) to
+ * a few radii out, the frames @c update_cut() takes until the cut stops
+ * changing (and it stops testing nodes), and the cameras whose cut never
+ * does.
+ * 
+ * Tiles are generated inline (no workers), so every frame sees the tiles the
+ * previous one asked for.
+ * 
+ * Usage: planet_core_lod_bench [cameras] [frames]
+ */
+
+#include "planet.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <boost/foreach.hpp>
+
+namespace
+{
+  using namespace planet_core;
+  
+  real_t random_unit()
+  {
+    return real_t(std::rand()) / RAND_MAX;
+  }
+  
+  void get_cut(const planet_t& planet, std::vector<node_handle_t>& cut)
+  {
+    cut.clear();
+    
+    BOOST_FOREACH(const planet_t::tree_type* visible, planet.visibles())
+      cut.push_back(visible->value());
+    
+    std::sort(cut.begin(), cut.end());
+  }
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  const real_t radius = 6353;
+  const std::size_t max_level = 31;
+  ///A cut that changed within this many frames of the last one has not settled
+  const std::size_t quiet_frames = 20;
+  
+  std::size_t cameras = argc > 1 ? std::size_t(std::atol(argv[1])) : 40;
+  std::size_t frames = argc > 2 ? std::max(std::size_t(std::atol(argv[2])), quiet_frames + 1) : 300;
+  
+  planet_t planet(radius, max_level, tile_layout_t(64, 17, 17), NULL, 0);
+  
+  planet.set_pixel_tolerance(4);
+  planet.set_merge_tolerance(2);
+  
+  std::srand(0);
+  
+  std::size_t unsettled = 0;
+  std::size_t slowest = 0;
+  std::vector<node_handle_t> cut;
+  std::vector<node_handle_t> last_cut;
+  
+  for (std::size_t camera = 0; camera < cameras; ++camera)
+  {
+    vector3_t direction(random_unit() - real_t(.5), random_unit() - real_t(.5), random_unit() - real_t(.5));
+    
+    ///Altitudes spread evenly over the orders of magnitude from a millionth of a radius to three radii
+    real_t altitude = radius * std::pow(real_t(10), real_t(-6) + random_unit() * real_t(6.5));
+    
+    lod_view_t view(direction.normalised() * (radius + altitude), 1, real_t(M_PI / 4), 768);
+    
+    std::size_t last_change = 0;
+    get_cut(planet, last_cut);
+    
+    for (std::size_t frame = 1; frame <= frames; ++frame)
+    {
+      planet.update_cut(view);
+      get_cut(planet, cut);
+      
+      ///A cut changed back within the call comes out the same, but has its nodes tested again
+      if (cut != last_cut || planet.lod_tests())
+        last_change = frame;
+      
+      cut.swap(last_cut);
+    }
+    
+    bool settled = last_change + quiet_frames <= frames;
+    
+    if (settled)
+      slowest = std::max(slowest, last_change);
+    else
+      ++unsettled;
+    
+    std::cout << "altitude " << altitude << ": " << last_cut.size() << " visibles, "
+              << (settled ? "settled after " : "still changing at ") << last_change << " frames" << std::endl;
+  }
+  
+  std::cout << unsettled << " of " << cameras << " cameras unsettled after " << frames << " frames; "
+            << "the others settled within " << slowest << std::endl;
+  
+  return unsettled == 0 ? 0 : 1;
+}
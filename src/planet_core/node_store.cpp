@@ -0,0 +1,283 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "node_store.h"
+
+#include <boost/assert.hpp>
+
+namespace planet_core
+{
+
+node_attachment_t::~node_attachment_t()
+{
+
+}
+
+node_store_t::node_store_t()
+  : msize(0)
+{
+
+}
+
+node_store_t::~node_store_t()
+{
+
+}
+
+node_handle_t node_store_t::create(const quad_key_t& key, const node_bounds_t& bounds, real_t error)
+{
+  boost::uint32_t slot;
+  
+  if (!free_slots.empty())
+  {
+    slot = free_slots.back();
+    free_slots.pop_back();
+    
+    keys[slot] = key;
+    centers[slot] = bounds.center;
+    radii[slot] = bounds.radius;
+    boxes[slot] = bounds.box;
+    directions[slot] = bounds.direction;
+    angular_radii[slot] = bounds.angular_radius;
+    heights_min[slot] = bounds.height_min;
+    heights_max[slot] = bounds.height_max;
+    normal_cones[slot] = normal_cone_t();
+    errors[slot] = error;
+    lod_anchors[slot] = vector3_t();
+    lod_slacks[slot] = 0;
+    mflags[slot] = 0;
+  } else {
+    slot = keys.size();
+    BOOST_ASSERT(slot <= INDEX_MASK);
+    
+    keys.push_back(key);
+    centers.push_back(bounds.center);
+    radii.push_back(bounds.radius);
+    boxes.push_back(bounds.box);
+    directions.push_back(bounds.direction);
+    angular_radii.push_back(bounds.angular_radius);
+    heights_min.push_back(bounds.height_min);
+    heights_max.push_back(bounds.height_max);
+    normal_cones.push_back(normal_cone_t());
+    errors.push_back(error);
+    lod_anchors.push_back(vector3_t());
+    lod_slacks.push_back(0);
+    mflags.push_back(0);
+    generations.push_back(1);
+    live.push_back(false);
+    cold.push_back(new cold_node_t);
+  }
+  
+  BOOST_ASSERT(!live[slot]);
+  BOOST_ASSERT(!cold[slot].tile && !cold[slot].attachment);
+  
+  live[slot] = true;
+  ++msize;
+  
+  return (generations[slot] << INDEX_BITS) | slot;
+}
+
+void node_store_t::destroy(node_handle_t node)
+{
+  std::size_t slot = index(node);
+  
+  ///The attachment may refer to the tile, so it goes first
+  cold[slot].attachment.reset();
+  cold[slot].tile.reset();
+  
+  live[slot] = false;
+  mflags[slot] = 0;
+  
+  ///Skip 0, so no handle is ever null
+  boost::uint32_t generation = (generations[slot] + 1) & GENERATION_MASK;
+  generations[slot] = generation ? generation : 1;
+  
+  free_slots.push_back(slot);
+  --msize;
+}
+
+bool node_store_t::alive(node_handle_t node) const
+{
+  std::size_t slot = node & INDEX_MASK;
+  
+  return slot < keys.size() && live[slot] && generations[slot] == (node >> INDEX_BITS);
+}
+
+std::size_t node_store_t::size() const
+{
+  return msize;
+}
+
+std::size_t node_store_t::index(node_handle_t node) const
+{
+  BOOST_ASSERT(alive(node));
+  return node & INDEX_MASK;
+}
+
+const quad_key_t& node_store_t::key(node_handle_t node) const
+{
+  return keys[index(node)];
+}
+
+const vector3_t& node_store_t::center(node_handle_t node) const
+{
+  return centers[index(node)];
+}
+
+real_t node_store_t::radius(node_handle_t node) const
+{
+  return radii[index(node)];
+}
+
+const oriented_box_t& node_store_t::box(node_handle_t node) const
+{
+  return boxes[index(node)];
+}
+
+const vector3_t& node_store_t::direction(node_handle_t node) const
+{
+  return directions[index(node)];
+}
+
+real_t node_store_t::angular_radius(node_handle_t node) const
+{
+  return angular_radii[index(node)];
+}
+
+real_t node_store_t::height_min(node_handle_t node) const
+{
+  return heights_min[index(node)];
+}
+
+real_t node_store_t::height_max(node_handle_t node) const
+{
+  return heights_max[index(node)];
+}
+
+real_t node_store_t::error(node_handle_t node) const
+{
+  return errors[index(node)];
+}
+
+void node_store_t::set_bounds(node_handle_t node, const node_bounds_t& bounds)
+{
+  std::size_t slot = index(node);
+  
+  centers[slot] = bounds.center;
+  radii[slot] = bounds.radius;
+  boxes[slot] = bounds.box;
+  directions[slot] = bounds.direction;
+  angular_radii[slot] = bounds.angular_radius;
+  heights_min[slot] = bounds.height_min;
+  heights_max[slot] = bounds.height_max;
+  
+  mflags[slot] &= ~LOD_VALID;
+}
+
+void node_store_t::set_error(node_handle_t node, real_t error)
+{
+  std::size_t slot = index(node);
+  
+  errors[slot] = error;
+  mflags[slot] &= ~LOD_VALID;
+}
+
+const normal_cone_t& node_store_t::normal_cone(node_handle_t node) const
+{
+  return normal_cones[index(node)];
+}
+
+void node_store_t::set_normal_cone(node_handle_t node, const normal_cone_t& cone)
+{
+  normal_cones[index(node)] = cone;
+}
+
+const vector3_t& node_store_t::lod_anchor(node_handle_t node) const
+{
+  return lod_anchors[index(node)];
+}
+
+real_t node_store_t::lod_slack(node_handle_t node) const
+{
+  return lod_slacks[index(node)];
+}
+
+void node_store_t::set_lod(node_handle_t node, bool acceptable, const vector3_t& anchor, real_t slack)
+{
+  std::size_t slot = index(node);
+  
+  lod_anchors[slot] = anchor;
+  lod_slacks[slot] = slack;
+  
+  mflags[slot] |= LOD_VALID;
+  
+  if (acceptable)
+    mflags[slot] |= LOD_ACCEPTABLE;
+  else
+    mflags[slot] &= ~LOD_ACCEPTABLE;
+}
+
+boost::uint8_t node_store_t::flags(node_handle_t node) const
+{
+  return mflags[index(node)];
+}
+
+bool node_store_t::test(node_handle_t node, boost::uint8_t mask) const
+{
+  return (mflags[index(node)] & mask) != 0;
+}
+
+void node_store_t::set(node_handle_t node, boost::uint8_t mask)
+{
+  mflags[index(node)] |= mask;
+}
+
+void node_store_t::clear(node_handle_t node, boost::uint8_t mask)
+{
+  mflags[index(node)] &= ~mask;
+}
+
+boost::scoped_ptr<tile_t>& node_store_t::tile(node_handle_t node)
+{
+  return cold[index(node)].tile;
+}
+
+const boost::scoped_ptr<tile_t>& node_store_t::tile(node_handle_t node) const
+{
+  return cold[index(node)].tile;
+}
+
+boost::scoped_ptr<node_attachment_t>& node_store_t::attachment(node_handle_t node)
+{
+  return cold[index(node)].attachment;
+}
+
+const boost::scoped_ptr<node_attachment_t>& node_store_t::attachment(node_handle_t node) const
+{
+  return cold[index(node)].attachment;
+}
+
+} // namespace planet_core
@@ -0,0 +1,192 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_NODE_STORE_H
+#define PLANET_CORE_NODE_STORE_H
+
+#include "types.h"
+#include "quad_key.h"
+#include "planet_geometry.h"
+#include "tile.h"
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+namespace planet_core
+{
+
+/**
+ * Names a node in a @c node_store_t: a slot index, and the generation of the
+ * slot, so a handle kept past its node's destruction is recognized as stale.
+ * 
+ * @c null_node_handle never names a node, so a default constructed handle is null.
+ */
+typedef boost::uint32_t node_handle_t;
+
+const node_handle_t null_node_handle = 0;
+
+///Resources a front end (e.g. the Ogre renderer) hangs off of a node
+struct node_attachment_t
+{
+  virtual ~node_attachment_t();
+};
+
+/**
+ * Every quad-node of a planet, stored field by field.
+ * 
+ * What the per-frame LOD walk reads (key, bounds, error, flags) is kept in
+ * dense parallel arrays indexed by the node's slot; the CPU tile and the
+ * front end's attachment are kept apart in a side table, so the walk never
+ * touches them. Slots of destroyed nodes are reused.
+ */
+struct node_store_t
+  : boost::noncopyable
+{
+  ///Node state bits
+  enum flag_t
+  {
+    ///A tile job for the node is pending
+    TILE_QUEUED = 1 << 0,
+    ///The node has its @c tile_t
+    TILE_READY = 1 << 1,
+    ///The front end has the tile uploaded; set and cleared by the front end
+    RESIDENT = 1 << 2,
+    ///The node's LOD decision is cached, see @c lod_anchor()
+    LOD_VALID = 1 << 3,
+    ///The cached LOD decision: the node's error is acceptable
+    LOD_ACCEPTABLE = 1 << 4,
+    ///The node is in the planet's visibles cut
+    VISIBLE = 1 << 5,
+    ///The node was merged into, and keeps its subtree until its grace period is over
+    MERGE_GRACE = 1 << 6
+  };
+  
+  node_store_t();
+  ~node_store_t();
+  
+  /**
+   * @param bounds planet relative bounds of the node's patch
+   * @param error geometric error of the node, in planet units, that the LOD metric projects to the screen
+   */
+  node_handle_t create(const quad_key_t& key, const node_bounds_t& bounds, real_t error);
+  ///Destroy the node, its tile and its attachment; @c node goes stale
+  void destroy(node_handle_t node);
+  
+  ///Whether @c node names a node that has not been destroyed
+  bool alive(node_handle_t node) const;
+  
+  ///Live nodes
+  std::size_t size() const;
+  
+  const quad_key_t& key(node_handle_t node) const;
+  ///Bounding sphere of the node's patch
+  const vector3_t& center(node_handle_t node) const;
+  real_t radius(node_handle_t node) const;
+  ///Oriented bounding box of the node's patch
+  const oriented_box_t& box(node_handle_t node) const;
+  ///Direction of the node's patch from the planet's center, and the angle around it the patch spans
+  const vector3_t& direction(node_handle_t node) const;
+  real_t angular_radius(node_handle_t node) const;
+  ///Displacement range the bounds cover
+  real_t height_min(node_handle_t node) const;
+  real_t height_max(node_handle_t node) const;
+  real_t error(node_handle_t node) const;
+  
+  ///Replace the node's error, e.g. once its tile has measured it; drops the cached LOD decision
+  void set_error(node_handle_t node, real_t error);
+  
+  ///Replace the node's bounds, e.g. once its height range is known; drops the cached LOD decision
+  void set_bounds(node_handle_t node, const node_bounds_t& bounds);
+  
+  ///Bounds the normals of the node's mesh; until set, one bounding every direction
+  const normal_cone_t& normal_cone(node_handle_t node) const;
+  void set_normal_cone(node_handle_t node, const normal_cone_t& cone);
+  
+  ///Camera position the cached LOD decision was made at
+  const vector3_t& lod_anchor(node_handle_t node) const;
+  ///How far the camera may move from @c lod_anchor() before the cached decision can change
+  real_t lod_slack(node_handle_t node) const;
+  ///Cache a LOD decision; sets @c LOD_VALID, and @c LOD_ACCEPTABLE as @c acceptable
+  void set_lod(node_handle_t node, bool acceptable, const vector3_t& anchor, real_t slack);
+  
+  boost::uint8_t flags(node_handle_t node) const;
+  bool test(node_handle_t node, boost::uint8_t mask) const;
+  void set(node_handle_t node, boost::uint8_t mask);
+  void clear(node_handle_t node, boost::uint8_t mask);
+  
+  ///CPU side noise and mesh; NULL until generated
+  boost::scoped_ptr<tile_t>& tile(node_handle_t node);
+  const boost::scoped_ptr<tile_t>& tile(node_handle_t node) const;
+  
+  ///Front end resources for this node, owned by the store
+  boost::scoped_ptr<node_attachment_t>& attachment(node_handle_t node);
+  const boost::scoped_ptr<node_attachment_t>& attachment(node_handle_t node) const;
+  
+private:
+  static const unsigned int INDEX_BITS = 20;
+  static const boost::uint32_t INDEX_MASK = (boost::uint32_t(1) << INDEX_BITS) - 1;
+  static const boost::uint32_t GENERATION_MASK = (boost::uint32_t(1) << (32 - INDEX_BITS)) - 1;
+  
+  ///Slot of a live @c node
+  std::size_t index(node_handle_t node) const;
+  
+  ///Rarely touched per-node state
+  struct cold_node_t
+  {
+    boost::scoped_ptr<tile_t> tile;
+    boost::scoped_ptr<node_attachment_t> attachment;
+  };
+  
+  //Hot fields, one entry per slot
+  std::vector<quad_key_t> keys;
+  std::vector<vector3_t> centers;
+  std::vector<real_t> radii;
+  std::vector<oriented_box_t> boxes;
+  std::vector<vector3_t> directions;
+  std::vector<real_t> angular_radii;
+  std::vector<real_t> heights_min;
+  std::vector<real_t> heights_max;
+  std::vector<normal_cone_t> normal_cones;
+  std::vector<real_t> errors;
+  std::vector<vector3_t> lod_anchors;
+  std::vector<real_t> lod_slacks;
+  std::vector<boost::uint8_t> mflags;
+  ///Generation of the slot's current (or next) node; never 0
+  std::vector<boost::uint32_t> generations;
+  std::vector<bool> live;
+  
+  boost::ptr_vector<cold_node_t> cold;
+  
+  std::vector<boost::uint32_t> free_slots;
+  std::size_t msize;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_NODE_STORE_H
@@ -0,0 +1,398 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "noise_batch.h"
+
+#include <cmath>
+#include <algorithm>
+#include <boost/assert.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLANET_CORE_NOISE_SSE2 1
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#endif
+
+namespace planet_core
+{
+
+void noise_batch_t::resize(std::size_t count)
+{
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  values.resize(count);
+}
+
+std::size_t noise_batch_t::size() const
+{
+  BOOST_ASSERT(x.size() == y.size() && y.size() == z.size() && z.size() == values.size());
+  return values.size();
+}
+
+
+ridged_multi_params_t::ridged_multi_params_t()
+  : frequency(1)
+  , lacunarity(2)
+  , exponent(1)
+  , offset(1)
+  , gain(2)
+  , scale(1)
+  , octave_count(6)
+  , seed(0)
+{
+
+}
+
+
+const float ridged_multi_kernel_t::tolerance = 1e-6f;
+const float ridged_multi_kernel_t::noisepp_tolerance = 1e-5f;
+
+namespace
+{
+  ///libnoise's lattice hashing constants
+  const boost::uint32_t x_noise_gen = 1619;
+  const boost::uint32_t y_noise_gen = 31337;
+  const boost::uint32_t z_noise_gen = 6971;
+  const boost::uint32_t seed_noise_gen = 1013;
+  const boost::uint32_t shift_noise_gen = 8;
+  
+  ///libnoise scales gradient noise by 2.12
+  const float gradient_scale = 2.12f;
+  
+  ///Integer floor, and the remaining fraction, of a lattice coordinate
+  inline void lattice(double x, boost::int32_t& i, float& f)
+  {
+    double t = double(boost::int32_t(x));
+    if (x < t)
+      t -= 1;
+    i = boost::int32_t(t);
+    f = float(x - t);
+  }
+  
+  inline float s_curve3(float a)
+  {
+    return a * a * (3.0f - 2.0f * a);
+  }
+  
+  inline float linear_interp(float n0, float n1, float a)
+  {
+    return ((1.0f - a) * n0) + (a * n1);
+  }
+  
+  inline float gradient_noise(float dx, float dy, float dz,
+                              boost::int32_t ix, boost::int32_t iy, boost::int32_t iz,
+                              boost::uint32_t seed, const gradient_table_t& gradients)
+  {
+    const float* g = &gradients[gradient_index(ix, iy, iz, seed) << 2];
+    
+    return ((g[0] * dx) + (g[1] * dy) + (g[2] * dz)) * gradient_scale;
+  }
+  
+  inline float gradient_coherent_noise(double x, double y, double z, boost::uint32_t seed, const gradient_table_t& gradients)
+  {
+    boost::int32_t x0, y0, z0;
+    float xf, yf, zf;
+    lattice(x, x0, xf);
+    lattice(y, y0, yf);
+    lattice(z, z0, zf);
+    
+    float xs = s_curve3(xf);
+    float ys = s_curve3(yf);
+    float zs = s_curve3(zf);
+    
+    float n0, n1, ix0, ix1, iy0, iy1;
+    n0  = gradient_noise(xf       , yf       , zf       , x0    , y0    , z0    , seed, gradients);
+    n1  = gradient_noise(xf - 1.0f, yf       , zf       , x0 + 1, y0    , z0    , seed, gradients);
+    ix0 = linear_interp(n0, n1, xs);
+    n0  = gradient_noise(xf       , yf - 1.0f, zf       , x0    , y0 + 1, z0    , seed, gradients);
+    n1  = gradient_noise(xf - 1.0f, yf - 1.0f, zf       , x0 + 1, y0 + 1, z0    , seed, gradients);
+    ix1 = linear_interp(n0, n1, xs);
+    iy0 = linear_interp(ix0, ix1, ys);
+    n0  = gradient_noise(xf       , yf       , zf - 1.0f, x0    , y0    , z0 + 1, seed, gradients);
+    n1  = gradient_noise(xf - 1.0f, yf       , zf - 1.0f, x0 + 1, y0    , z0 + 1, seed, gradients);
+    ix0 = linear_interp(n0, n1, xs);
+    n0  = gradient_noise(xf       , yf - 1.0f, zf - 1.0f, x0    , y0 + 1, z0 + 1, seed, gradients);
+    n1  = gradient_noise(xf - 1.0f, yf - 1.0f, zf - 1.0f, x0 + 1, y0 + 1, z0 + 1, seed, gradients);
+    ix1 = linear_interp(n0, n1, xs);
+    iy1 = linear_interp(ix0, ix1, ys);
+    
+    return linear_interp(iy0, iy1, zs);
+  }
+  
+#ifdef PLANET_CORE_NOISE_SSE2
+  
+  inline __m128i mullo_epi32(__m128i a, __m128i b)
+  {
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+#endif
+  }
+  
+  ///Four lattice coordinates, kept as two pairs of doubles
+  struct lattice4_t
+  {
+    __m128d lo;
+    __m128d hi;
+  };
+  
+  inline void lattice(const lattice4_t& x, __m128i& i, __m128& f)
+  {
+    const __m128d one = _mm_set1_pd(1.0);
+    
+    __m128d tlo = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x.lo));
+    __m128d thi = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x.hi));
+    tlo = _mm_sub_pd(tlo, _mm_and_pd(_mm_cmplt_pd(x.lo, tlo), one));
+    thi = _mm_sub_pd(thi, _mm_and_pd(_mm_cmplt_pd(x.hi, thi), one));
+    
+    i = _mm_unpacklo_epi64(_mm_cvttpd_epi32(tlo), _mm_cvttpd_epi32(thi));
+    f = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(x.lo, tlo)),
+                      _mm_cvtpd_ps(_mm_sub_pd(x.hi, thi)));
+  }
+  
+  inline __m128 s_curve3(__m128 a)
+  {
+    return _mm_mul_ps(_mm_mul_ps(a, a), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), a)));
+  }
+  
+  inline __m128 linear_interp(__m128 n0, __m128 n1, __m128 a)
+  {
+    return _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a), n0), _mm_mul_ps(a, n1));
+  }
+  
+  ///@param h the unmixed lattice hash of the corner
+  inline __m128 gradient_noise(__m128 dx, __m128 dy, __m128 dz, __m128i h, const gradient_table_t& gradients)
+  {
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, shift_noise_gen));
+    h = _mm_and_si128(h, _mm_set1_epi32(0xff));
+    
+    ///No gather in SSE; load each lane's padded gradient and transpose them into components
+    boost::uint32_t index[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(index), h);
+    
+    __m128 gx = _mm_loadu_ps(&gradients[index[0] << 2]);
+    __m128 gy = _mm_loadu_ps(&gradients[index[1] << 2]);
+    __m128 gz = _mm_loadu_ps(&gradients[index[2] << 2]);
+    __m128 gw = _mm_loadu_ps(&gradients[index[3] << 2]);
+    _MM_TRANSPOSE4_PS(gx, gy, gz, gw);
+    
+    return _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, dx), _mm_mul_ps(gy, dy)), _mm_mul_ps(gz, dz)),
+                      _mm_set1_ps(gradient_scale));
+  }
+  
+  inline __m128 gradient_coherent_noise(const lattice4_t& x, const lattice4_t& y, const lattice4_t& z,
+                                        boost::uint32_t seed, const gradient_table_t& gradients)
+  {
+    __m128i x0, y0, z0;
+    __m128 xf, yf, zf;
+    lattice(x, x0, xf);
+    lattice(y, y0, yf);
+    lattice(z, z0, zf);
+    
+    __m128 xs = s_curve3(xf);
+    __m128 ys = s_curve3(yf);
+    __m128 zs = s_curve3(zf);
+    
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 xf1 = _mm_sub_ps(xf, one);
+    __m128 yf1 = _mm_sub_ps(yf, one);
+    __m128 zf1 = _mm_sub_ps(zf, one);
+    
+    ///The hash is linear in the lattice coordinates, so neighbouring corners only add constants
+    __m128i h000 = _mm_add_epi32(_mm_add_epi32(mullo_epi32(x0, _mm_set1_epi32(x_noise_gen)),
+                                               mullo_epi32(y0, _mm_set1_epi32(y_noise_gen))),
+                                 _mm_add_epi32(mullo_epi32(z0, _mm_set1_epi32(z_noise_gen)),
+                                               _mm_set1_epi32(seed_noise_gen * seed)));
+    const __m128i hx = _mm_set1_epi32(x_noise_gen);
+    const __m128i hy = _mm_set1_epi32(y_noise_gen);
+    const __m128i hz = _mm_set1_epi32(z_noise_gen);
+    __m128i h010 = _mm_add_epi32(h000, hy);
+    __m128i h001 = _mm_add_epi32(h000, hz);
+    __m128i h011 = _mm_add_epi32(h010, hz);
+    
+    __m128 n0, n1, ix0, ix1, iy0, iy1;
+    n0  = gradient_noise(xf , yf , zf , h000, gradients);
+    n1  = gradient_noise(xf1, yf , zf , _mm_add_epi32(h000, hx), gradients);
+    ix0 = linear_interp(n0, n1, xs);
+    n0  = gradient_noise(xf , yf1, zf , h010, gradients);
+    n1  = gradient_noise(xf1, yf1, zf , _mm_add_epi32(h010, hx), gradients);
+    ix1 = linear_interp(n0, n1, xs);
+    iy0 = linear_interp(ix0, ix1, ys);
+    n0  = gradient_noise(xf , yf , zf1, h001, gradients);
+    n1  = gradient_noise(xf1, yf , zf1, _mm_add_epi32(h001, hx), gradients);
+    ix0 = linear_interp(n0, n1, xs);
+    n0  = gradient_noise(xf , yf1, zf1, h011, gradients);
+    n1  = gradient_noise(xf1, yf1, zf1, _mm_add_epi32(h011, hx), gradients);
+    ix1 = linear_interp(n0, n1, xs);
+    iy1 = linear_interp(ix0, ix1, ys);
+    
+    return linear_interp(iy0, iy1, zs);
+  }
+  
+  inline lattice4_t load_lattice(const float* p, double frequency)
+  {
+    __m128 v = _mm_loadu_ps(p);
+    __m128d f = _mm_set1_pd(frequency);
+    lattice4_t result;
+    result.lo = _mm_mul_pd(_mm_cvtps_pd(v), f);
+    result.hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), f);
+    return result;
+  }
+  
+  inline void scale_lattice(lattice4_t& x, double s)
+  {
+    __m128d sd = _mm_set1_pd(s);
+    x.lo = _mm_mul_pd(x.lo, sd);
+    x.hi = _mm_mul_pd(x.hi, sd);
+  }
+#endif
+} // anonymous namespace
+
+
+boost::uint32_t gradient_index(boost::int32_t ix, boost::int32_t iy, boost::int32_t iz, boost::uint32_t seed)
+{
+  boost::uint32_t h = x_noise_gen * boost::uint32_t(ix)
+                    + y_noise_gen * boost::uint32_t(iy)
+                    + z_noise_gen * boost::uint32_t(iz)
+                    + seed_noise_gen * seed;
+  h ^= (h >> shift_noise_gen);
+  return h & 0xff;
+}
+
+ridged_multi_kernel_t::ridged_multi_kernel_t(const ridged_multi_params_t& params, const gradient_table_t& gradients)
+  : params(params)
+  , gradients(gradients)
+{
+  BOOST_ASSERT(params.octave_count <= max_octaves);
+  
+  ///Same spectral weights as libnoise: frequency^-exponent per octave
+  double frequency = 1;
+  for (std::size_t i = 0; i < max_octaves; ++i)
+  {
+    spectral_weights[i] = float(std::pow(frequency, -double(params.exponent)));
+    frequency *= params.lacunarity;
+  }
+}
+
+float ridged_multi_kernel_t::evaluate_scalar(float fx, float fy, float fz) const
+{
+  double x = double(fx) * params.frequency;
+  double y = double(fy) * params.frequency;
+  double z = double(fz) * params.frequency;
+  
+  float value = 0.0f;
+  float weight = 1.0f;
+  
+  for (std::size_t octave = 0; octave < params.octave_count; ++octave)
+  {
+    BOOST_ASSERT(std::fabs(x) < 1073741824.0 && std::fabs(y) < 1073741824.0 && std::fabs(z) < 1073741824.0);
+    
+    boost::uint32_t seed = (boost::uint32_t(params.seed) + octave) & 0x7fffffff;
+    float signal = gradient_coherent_noise(x, y, z, seed, gradients);
+    
+    signal = std::fabs(signal);
+    signal = params.offset - signal;
+    signal *= signal;
+    signal *= weight;
+    
+    weight = signal * params.gain;
+    weight = std::min(std::max(weight, 0.0f), 1.0f);
+    
+    value += signal * spectral_weights[octave];
+    
+    x *= params.lacunarity;
+    y *= params.lacunarity;
+    z *= params.lacunarity;
+  }
+  
+  return (value * 1.25f - 1.0f) * params.scale;
+}
+
+void ridged_multi_kernel_t::evaluate_scalar(const float* x, const float* y, const float* z, float* values, std::size_t count) const
+{
+  for (std::size_t i = 0; i < count; ++i)
+    values[i] = evaluate_scalar(x[i], y[i], z[i]);
+}
+
+void ridged_multi_kernel_t::evaluate(const float* x, const float* y, const float* z, float* values, std::size_t count) const
+{
+#ifdef PLANET_CORE_NOISE_SSE2
+  const std::size_t simd_count = count & ~std::size_t(3);
+  
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 offset = _mm_set1_ps(params.offset);
+  const __m128 gain = _mm_set1_ps(params.gain);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  
+  for (std::size_t i = 0; i < simd_count; i += 4)
+  {
+    lattice4_t lx = load_lattice(x + i, params.frequency);
+    lattice4_t ly = load_lattice(y + i, params.frequency);
+    lattice4_t lz = load_lattice(z + i, params.frequency);
+    
+    __m128 value = zero;
+    __m128 weight = one;
+    
+    for (std::size_t octave = 0; octave < params.octave_count; ++octave)
+    {
+      boost::uint32_t seed = (boost::uint32_t(params.seed) + octave) & 0x7fffffff;
+      __m128 signal = gradient_coherent_noise(lx, ly, lz, seed, gradients);
+      
+      signal = _mm_and_ps(signal, abs_mask);
+      signal = _mm_sub_ps(offset, signal);
+      signal = _mm_mul_ps(signal, signal);
+      signal = _mm_mul_ps(signal, weight);
+      
+      weight = _mm_mul_ps(signal, gain);
+      weight = _mm_min_ps(_mm_max_ps(weight, zero), one);
+      
+      value = _mm_add_ps(value, _mm_mul_ps(signal, _mm_set1_ps(spectral_weights[octave])));
+      
+      scale_lattice(lx, params.lacunarity);
+      scale_lattice(ly, params.lacunarity);
+      scale_lattice(lz, params.lacunarity);
+    }
+    
+    value = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(value, _mm_set1_ps(1.25f)), one), _mm_set1_ps(params.scale));
+    _mm_storeu_ps(values + i, value);
+  }
+  
+  ///Remainder
+  evaluate_scalar(x + simd_count, y + simd_count, z + simd_count, values + simd_count, count - simd_count);
+#else
+  evaluate_scalar(x, y, z, values, count);
+#endif
+}
+
+} // namespace planet_core
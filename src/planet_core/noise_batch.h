@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_NOISE_BATCH_H
+#define PLANET_CORE_NOISE_BATCH_H
+
+#include "types.h"
+
+#include <vector>
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+namespace planet_core
+{
+
+///Structure-of-arrays noise request: one sample per index of @c x, @c y, @c z
+struct noise_batch_t
+{
+  void resize(std::size_t count);
+  std::size_t size() const;
+  
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  
+  ///Output, one value per sample
+  std::vector<float> values;
+};
+
+
+///The settings of a ridged-multifractal stack, as handed to noisepp::RidgedMultiModule
+struct ridged_multi_params_t
+{
+  ///Defaults match noisepp/libnoise
+  ridged_multi_params_t();
+  
+  double frequency;
+  double lacunarity;
+  float exponent;
+  float offset;
+  float gain;
+  ///Applied to the final value
+  float scale;
+  std::size_t octave_count;
+  boost::int32_t seed;
+};
+
+/**
+ * libnoise's gradient table, as noisepp uses it: 256 unit vectors, each padded
+ * with a zero to four components. Indexed by the mixed lattice hash.
+ */
+typedef boost::array<float, 256 * 4> gradient_table_t;
+
+///The entry of @c gradient_table_t for a lattice point and seed, hashed as libnoise does
+boost::uint32_t gradient_index(boost::int32_t ix, boost::int32_t iy, boost::int32_t iz, boost::uint32_t seed);
+
+/**
+ * Vectorized ridged-multifractal evaluation.
+ * 
+ * Follows the noisepp/libnoise RidgedMulti recurrence (lattice hash, gradient
+ * table, cubic s-curve, per octave seeds, spectral weights, offset, gain,
+ * lacunarity) with the gradient table it is given; see
+ * @c noise_hierarchy_t for where that comes from. The result agrees with
+ * noisepp::RidgedMultiModule (built with double precision) to within
+ * @c noisepp_tolerance; the kernel works in floats, so not to the bit.
+ * 
+ * The SSE path and @c evaluate_scalar() perform the same float operations in the
+ * same order and agree to within @c tolerance (observed: exact) on any machine;
+ * lattice coordinates are kept in double precision in both, so large planet
+ * relative coordinates times @c frequency do not lose their fractional part.
+ * 
+ * Inputs must satisfy |coordinate * frequency * lacunarity^(octaves-1)| < 2^30.
+ */
+struct ridged_multi_kernel_t
+{
+  static const std::size_t max_octaves = 30;
+  
+  ///Max absolute difference between the SIMD and scalar paths
+  static const float tolerance;
+  ///Max absolute difference from noisepp with the same settings, per unit of @c params.scale
+  static const float noisepp_tolerance;
+  
+  ridged_multi_kernel_t(const ridged_multi_params_t& params, const gradient_table_t& gradients);
+  
+  void evaluate(const float* x, const float* y, const float* z, float* values, std::size_t count) const;
+  
+  float evaluate_scalar(float x, float y, float z) const;
+  
+  const ridged_multi_params_t params;
+private:
+  void evaluate_scalar(const float* x, const float* y, const float* z, float* values, std::size_t count) const;
+  
+  const gradient_table_t gradients;
+  boost::array<float, max_octaves> spectral_weights;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_NOISE_BATCH_H
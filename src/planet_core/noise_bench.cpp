@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+ * Throughput of the noise stack through noisepp versus the batched kernel,
+ * the kernel's agreement with noisepp, and the agreement of its SIMD and
+ * scalar paths.
+ * 
+ * Usage: planet_core_noise_bench [samples] [level]
+ */
+
+#include "noise_stack.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace
+{
+  double seconds_since(const boost::posix_time::ptime& start)
+  {
+    return double((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds()) / 1e6;
+  }
+  
+  void report(const char* name, std::size_t samples, double seconds)
+  {
+    std::cout << name << ": " << samples << " samples in " << seconds << "s, "
+              << (double(samples) / seconds) << " samples/s" << std::endl;
+  }
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  using namespace planet_core;
+  
+  const real_t radius = 10000;
+  const std::size_t max_level = 20;
+  
+  std::size_t samples = argc > 1 ? std::size_t(std::atol(argv[1])) : 1 << 20;
+  std::size_t level = argc > 2 ? std::min(std::size_t(std::atol(argv[2])), max_level) : 0;
+  
+  ///Points on the sphere, as the tile generator would request them
+  noise_batch_t batch;
+  batch.resize(samples);
+  
+  std::srand(0);
+  for (std::size_t i = 0; i < samples; ++i)
+  {
+    vector3_t p(real_t(std::rand()) / RAND_MAX - real_t(0.5),
+                real_t(std::rand()) / RAND_MAX - real_t(0.5),
+                real_t(std::rand()) / RAND_MAX - real_t(0.5));
+    p = p.normalised() * radius;
+    batch.x[i] = p.x;
+    batch.y[i] = p.y;
+    batch.z[i] = p.z;
+  }
+  
+  noise_hierarchy_t pipeline_hierarchy(radius, max_level, false);
+  noise_hierarchy_t kernel_hierarchy(radius, max_level, true);
+  
+  if (!kernel_hierarchy.batch_kernel())
+  {
+    std::cout << "noisepp's gradient noise is not libnoise's; the kernel cannot reproduce it" << std::endl;
+    return 1;
+  }
+  
+  noise_context_t pipeline_context(pipeline_hierarchy);
+  noise_context_t kernel_context(kernel_hierarchy);
+  
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  pipeline_context.evaluate(level, batch);
+  report("noisepp", samples, seconds_since(start));
+  
+  std::vector<float> pipeline_values(batch.values);
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  kernel_context.evaluate(level, batch);
+  report("kernel", samples, seconds_since(start));
+  
+  const ridged_multi_kernel_t& kernel = *kernel_hierarchy.get(level).kernel;
+  
+  float max_noisepp_difference = 0;
+  for (std::size_t i = 0; i < samples; ++i)
+    max_noisepp_difference = std::max(max_noisepp_difference, std::fabs(pipeline_values[i] - batch.values[i]));
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  float max_difference = 0;
+  for (std::size_t i = 0; i < samples; ++i)
+  {
+    float scalar = kernel.evaluate_scalar(batch.x[i], batch.y[i], batch.z[i]);
+    max_difference = std::max(max_difference, std::fabs(scalar - batch.values[i]));
+  }
+  report("kernel (scalar)", samples, seconds_since(start));
+  
+  const float noisepp_tolerance = ridged_multi_kernel_t::noisepp_tolerance * kernel.params.scale;
+  
+  std::cout << "max |kernel - noisepp|: " << max_noisepp_difference
+            << " (tolerance " << noisepp_tolerance << ")" << std::endl;
+  std::cout << "max |simd - scalar|: " << max_difference
+            << " (tolerance " << ridged_multi_kernel_t::tolerance << ")" << std::endl;
+  
+  return max_noisepp_difference <= noisepp_tolerance && max_difference <= ridged_multi_kernel_t::tolerance ? 0 : 1;
+}
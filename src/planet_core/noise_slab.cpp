@@ -0,0 +1,142 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "noise_slab.h"
+
+#include <new>
+#include <boost/assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+namespace planet_core
+{
+
+namespace
+{
+  std::size_t round_up(std::size_t bytes, std::size_t alignment)
+  {
+    return (bytes + alignment - 1) / alignment * alignment;
+  }
+} // anonymous namespace
+
+
+noise_tile_t::noise_tile_t(noise_slab_t& slab)
+  : slab(&slab)
+  , references(0)
+{
+
+}
+
+float* noise_tile_t::values()
+{
+  return reinterpret_cast<float*>(this + 1);
+}
+
+const float* noise_tile_t::values() const
+{
+  return reinterpret_cast<const float*>(this + 1);
+}
+
+void intrusive_ptr_add_ref(noise_tile_t* tile)
+{
+  ++tile->references;
+}
+
+void intrusive_ptr_release(noise_tile_t* tile)
+{
+  if (--tile->references == 0)
+    tile->slab->release(tile);
+}
+
+
+noise_slab_t::noise_slab_t(std::size_t tile_size, std::size_t tiles_per_block)
+  : tile_size(tile_size)
+  , tiles_per_block(tiles_per_block)
+  , tile_stride(round_up(sizeof(noise_tile_t) + tile_size * sizeof(float), boost::alignment_of<noise_tile_t>::value))
+{
+  BOOST_ASSERT(tile_size > 0);
+  BOOST_ASSERT(tiles_per_block > 0);
+  BOOST_ASSERT(sizeof(noise_tile_t) % boost::alignment_of<float>::value == 0);
+}
+
+noise_slab_t::~noise_slab_t()
+{
+  BOOST_ASSERT(free_tiles.size() == blocks.size() * tiles_per_block);
+  
+  for (std::size_t i = 0; i < blocks.size(); ++i)
+    delete[] blocks[i];
+}
+
+noise_tile_ptr_t noise_slab_t::allocate()
+{
+  char* storage = NULL;
+  
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    
+    if (free_tiles.empty())
+    {
+      ///new[] aligns for any type, and the stride keeps every later tile aligned too
+      char* block = new char[tile_stride * tiles_per_block];
+      blocks.push_back(block);
+      
+      ///Hand out the block front to back
+      for (std::size_t i = tiles_per_block; i > 0; --i)
+        free_tiles.push_back(block + (i - 1) * tile_stride);
+    }
+    
+    storage = free_tiles.back();
+    free_tiles.pop_back();
+  }
+  
+  return noise_tile_ptr_t(new (storage) noise_tile_t(*this));
+}
+
+void noise_slab_t::release(noise_tile_t* tile)
+{
+  tile->~noise_tile_t();
+  
+  boost::mutex::scoped_lock lock(mutex);
+  
+  BOOST_ASSERT(free_tiles.size() < blocks.size() * tiles_per_block);
+  
+  free_tiles.push_back(reinterpret_cast<char*>(tile));
+}
+
+std::size_t noise_slab_t::used() const
+{
+  boost::mutex::scoped_lock lock(mutex);
+  
+  return blocks.size() * tiles_per_block - free_tiles.size();
+}
+
+std::size_t noise_slab_t::capacity() const
+{
+  boost::mutex::scoped_lock lock(mutex);
+  
+  return blocks.size() * tiles_per_block;
+}
+
+} // namespace planet_core
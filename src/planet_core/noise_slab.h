@@ -0,0 +1,107 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_NOISE_SLAB_H
+#define PLANET_CORE_NOISE_SLAB_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace planet_core
+{
+
+struct noise_slab_t;
+
+/**
+ * A noise tile in a @c noise_slab_t: its reference count, then its
+ * @c noise_slab_t::tile_size floats, all in the slab's block, so handing a
+ * tile out allocates nothing.
+ */
+struct noise_tile_t
+  : boost::noncopyable
+{
+  float* values();
+  const float* values() const;
+private:
+  friend struct noise_slab_t;
+  friend void intrusive_ptr_add_ref(noise_tile_t* tile);
+  friend void intrusive_ptr_release(noise_tile_t* tile);
+  
+  explicit noise_tile_t(noise_slab_t& slab);
+  
+  noise_slab_t* const slab;
+  boost::detail::atomic_count references;
+};
+
+void intrusive_ptr_add_ref(noise_tile_t* tile);
+void intrusive_ptr_release(noise_tile_t* tile);
+
+///A reference to a noise tile; the tile goes back to its slab when the last one is dropped
+typedef boost::intrusive_ptr<noise_tile_t> noise_tile_ptr_t;
+
+/**
+ * The authoritative, CPU side, store of noise tiles.
+ * 
+ * Tiles are all @c tile_size floats, carved out of blocks of @c tiles_per_block
+ * and recycled through a free list, so a split costs no heap traffic once the
+ * slab is warm. GPU textures are only ever written from here, never read back.
+ * 
+ * Thread safe; the slab must outlive every tile it hands out.
+ */
+struct noise_slab_t
+  : boost::noncopyable
+{
+  explicit noise_slab_t(std::size_t tile_size, std::size_t tiles_per_block = 64);
+  ~noise_slab_t();
+  
+  noise_tile_ptr_t allocate();
+  
+  ///Tiles handed out and not yet returned
+  std::size_t used() const;
+  ///Tiles the current blocks can hold
+  std::size_t capacity() const;
+  
+  const std::size_t tile_size;
+  const std::size_t tiles_per_block;
+private:
+  friend void intrusive_ptr_release(noise_tile_t* tile);
+  
+  void release(noise_tile_t* tile);
+  
+  ///Bytes from one tile to the next in a block: the header, then the floats, padded for the next header
+  const std::size_t tile_stride;
+  
+  mutable boost::mutex mutex;
+  std::vector<char*> blocks;
+  std::vector<char*> free_tiles;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_NOISE_SLAB_H
@@ -0,0 +1,297 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "noise_stack.h"
+
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include <boost/assert.hpp>
+#include <boost/foreach.hpp>
+#include <NoisePerlin.h>
+#include <NoiseRidgedMulti.h>
+
+namespace planet_core
+{
+
+noise_stack_t::noise_stack_t()
+  : result_element(NULL)
+{
+
+}
+
+noise_stack_t::~noise_stack_t()
+{
+  BOOST_ASSERT(free_caches.size() == caches.size());
+  
+  BOOST_FOREACH(noisepp::Cache* cache, caches)
+  {
+    pipeline.freeCache(cache);
+  }
+}
+
+noisepp::Cache* noise_stack_t::acquire_cache()
+{
+  if (!free_caches.empty())
+  {
+    noisepp::Cache* cache = free_caches.back();
+    free_caches.pop_back();
+    return cache;
+  }
+  
+  caches.push_back(pipeline.createCache());
+  return caches.back();
+}
+
+void noise_stack_t::release_cache(noisepp::Cache* cache)
+{
+  BOOST_ASSERT(std::find(caches.begin(), caches.end(), cache) != caches.end());
+  BOOST_ASSERT(std::find(free_caches.begin(), free_caches.end(), cache) == free_caches.end());
+  
+  free_caches.push_back(cache);
+}
+
+void noise_stack_t::evaluate(noise_batch_t& batch, noisepp::Cache* cache) const
+{
+  const std::size_t count = batch.size();
+  
+  if (count == 0)
+    return;
+  
+  if (kernel)
+  {
+    kernel->evaluate(&batch.x[0], &batch.y[0], &batch.z[0], &batch.values[0], count);
+    return;
+  }
+  
+  BOOST_ASSERT(!!result_element);
+  BOOST_ASSERT(cache);
+  
+  for (std::size_t i = 0; i < count; ++i)
+    batch.values[i] = result_element->getValue(batch.x[i], batch.y[i], batch.z[i], cache);
+}
+
+
+namespace
+{
+  ///Record one reading of a gradient component; false if it disagrees with an earlier reading
+  bool read_component(gradient_table_t& gradients, std::vector<bool>& read, std::size_t& unread,
+                      boost::uint32_t index, std::size_t axis, double value)
+  {
+    ///Readings of one component further apart than this mean noisepp does not hash like libnoise
+    const double agreement = 1e-4;
+    
+    float& component = gradients[(index << 2) + axis];
+    
+    if (read[index])
+      return std::fabs(component - value) <= agreement;
+    
+    component = float(value);
+    read[index] = true;
+    --unread;
+    return true;
+  }
+  
+  /**
+   * Fill @p gradients from noisepp's gradient noise.
+   * 
+   * On a lattice edge along x, one octave of Perlin noise only involves the x
+   * components @c a and @c b of the gradients at the edge's ends, linearly:
+   * n(t) = 2.12 * ((1 - s(t)) * t * a + s(t) * (t - 1) * b), with s the cubic
+   * s-curve. Two samples on the edge give both; edges along y and z give the
+   * other components. Most gradients are read from several edges.
+   * 
+   * @return false if some gradient was never reached, or its readings
+   *         disagree, i.e. noisepp's noise is not libnoise's.
+   */
+  bool read_gradient_table(gradient_table_t& gradients)
+  {
+    const std::size_t entries = gradients.size() / 4;
+    const boost::int32_t max_edges = 1 << 16;
+    
+    const double t[2] = {0.25, 0.75};
+    double a[2], b[2];
+    for (std::size_t j = 0; j < 2; ++j)
+    {
+      double s = t[j] * t[j] * (3.0 - 2.0 * t[j]);
+      a[j] = 2.12 * (1.0 - s) * t[j];
+      b[j] = 2.12 * s * (t[j] - 1.0);
+    }
+    const double det = a[0] * b[1] - b[0] * a[1];
+    
+    noisepp::Pipeline3D pipeline;
+    noisepp::PerlinModule perlin;
+    perlin.setFrequency(1);
+    perlin.setOctaveCount(1);
+    perlin.setSeed(0);
+    
+    noisepp::PipelineElement3D* element = pipeline.getElement(perlin.addToPipeline(&pipeline));
+    noisepp::Cache* cache = pipeline.createCache();
+    
+    gradients.assign(0);
+    
+    bool consistent = true;
+    
+    for (std::size_t axis = 0; axis < 3 && consistent; ++axis)
+    {
+      std::vector<bool> read(entries, false);
+      std::size_t unread = entries;
+      
+      for (boost::int32_t k = 1; k < max_edges && unread > 0 && consistent; ++k)
+      {
+        double n[2];
+        for (std::size_t j = 0; j < 2; ++j)
+        {
+          double p[3] = {1, 1, 1};
+          p[axis] = k + t[j];
+          n[j] = element->getValue(p[0], p[1], p[2], cache);
+        }
+        
+        boost::int32_t ends[2][3] = {{1, 1, 1}, {1, 1, 1}};
+        ends[0][axis] = k;
+        ends[1][axis] = k + 1;
+        
+        consistent = read_component(gradients, read, unread, gradient_index(ends[0][0], ends[0][1], ends[0][2], 0),
+                                    axis, (n[0] * b[1] - b[0] * n[1]) / det)
+                  && read_component(gradients, read, unread, gradient_index(ends[1][0], ends[1][1], ends[1][2], 0),
+                                    axis, (a[0] * n[1] - n[0] * a[1]) / det);
+      }
+      
+      consistent = consistent && unread == 0;
+    }
+    
+    pipeline.freeCache(cache);
+    
+    return consistent;
+  }
+} // anonymous namespace
+
+noise_hierarchy_t::noise_hierarchy_t(real_t radius, std::size_t max_level, bool batch_kernel)
+  : radius(radius)
+  , max_level(max_level)
+{
+  if (batch_kernel)
+  {
+    std::auto_ptr<gradient_table_t> table(new gradient_table_t);
+    
+    if (read_gradient_table(*table))
+      gradients.reset(table.release());
+  }
+}
+
+bool noise_hierarchy_t::batch_kernel() const
+{
+  return !!gradients;
+}
+
+noise_stack_t& noise_hierarchy_t::get(std::size_t level)
+{
+  BOOST_ASSERT(level <= max_level);
+  
+  if (!(level < stacks.size()))
+  {
+    stacks.resize(level + 1);
+  }
+  
+  if (!stacks[level].result_element)
+  {
+    noise_stack_t& noise_stack = stacks[level];
+    
+    std::auto_ptr< noisepp::RidgedMultiModule > caves_ptr(new noisepp::RidgedMultiModule);
+    noisepp::RidgedMultiModule& caves = *caves_ptr;
+    noise_stack.modules.push_back(caves_ptr);
+    
+    ridged_multi_params_t params;
+    params.frequency = radius / 2;
+    params.octave_count = 2;
+    params.scale = 2;
+    params.gain = 2;
+    
+    caves.setFrequency(params.frequency);
+    caves.setOctaveCount(params.octave_count);
+    caves.setScale(params.scale);
+    caves.setGain(params.gain);
+    
+    noisepp::ElementID element_id = caves.addToPipeline(&noise_stack.pipeline);
+    
+    noise_stack.result_element = noise_stack.pipeline.getElement(element_id);
+    
+    if (gradients)
+      noise_stack.kernel.reset(new ridged_multi_kernel_t(params, *gradients));
+  }
+  
+  BOOST_ASSERT(!!stacks[level].result_element);
+  
+  return stacks[level];
+}
+
+
+
+noise_context_t::entry_t::entry_t()
+  : stack(NULL)
+  , cache(NULL)
+{
+
+}
+
+noise_context_t::noise_context_t(noise_hierarchy_t& hierarchy)
+  : hierarchy(hierarchy)
+{
+
+}
+
+noise_context_t::~noise_context_t()
+{
+  boost::mutex::scoped_lock lock(hierarchy.mutex);
+  
+  BOOST_FOREACH(entry_t& entry, entries)
+  {
+    if (entry.cache)
+      entry.stack->release_cache(entry.cache);
+  }
+}
+
+void noise_context_t::evaluate(std::size_t level, noise_batch_t& batch)
+{
+  if (!(level < entries.size()))
+  {
+    entries.resize(level + 1);
+  }
+  
+  entry_t& entry = entries[level];
+  
+  if (!entry.stack)
+  {
+    boost::mutex::scoped_lock lock(hierarchy.mutex);
+    
+    entry.stack = &hierarchy.get(level);
+    entry.cache = entry.stack->acquire_cache();
+  }
+  
+  entry.stack->evaluate(batch, entry.cache);
+}
+
+} // namespace planet_core
@@ -0,0 +1,144 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_NOISE_STACK_H
+#define PLANET_CORE_NOISE_STACK_H
+
+#include "types.h"
+#include "noise_batch.h"
+
+#include <NoisePipeline.h>
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/ptr_container/ptr_list.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+///Evaluate the noise stacks with @c ridged_multi_kernel_t instead of noisepp by default
+#ifndef PLANET_CORE_BATCH_NOISE_KERNEL
+#define PLANET_CORE_BATCH_NOISE_KERNEL 0
+#endif
+
+namespace planet_core
+{
+
+///The noise modules and pipeline used to generate one level of the planet
+struct noise_stack_t
+  : boost::noncopyable
+{
+  noise_stack_t();
+  ~noise_stack_t();
+  
+  ///Fill @c batch.values, through @c kernel when present, else through the pipeline.
+  ///Thread safe as long as no two threads share @c cache
+  void evaluate(noise_batch_t& batch, noisepp::Cache* cache) const;
+  
+  ///Take a cache from the pool, creating one if it is empty; not thread safe
+  noisepp::Cache* acquire_cache();
+  ///Return a cache taken with @c acquire_cache(); not thread safe
+  void release_cache(noisepp::Cache* cache);
+  
+  noisepp::Pipeline3D pipeline;
+  noisepp::PipelineElement3D* result_element;
+  
+  boost::ptr_list< noisepp::Module > modules;
+  
+  ///Vectorized equivalent of the pipeline, if enabled; agrees with it to within @c ridged_multi_kernel_t::noisepp_tolerance
+  boost::scoped_ptr<ridged_multi_kernel_t> kernel;
+private:
+  ///Every cache created for this stack, and the ones currently free
+  std::vector<noisepp::Cache*> caches;
+  std::vector<noisepp::Cache*> free_caches;
+};
+
+/**
+ * Lazily builds one @c noise_stack_t per level of the planet.
+ * 
+ * With @c batch_kernel, the stacks evaluate through @c ridged_multi_kernel_t,
+ * fed with noisepp's gradient table. noisepp does not export the table, so the
+ * constructor reads it back out of noisepp's own gradient noise; if noisepp
+ * does not hash the lattice like libnoise, the readings disagree and the
+ * stacks stay on the pipeline.
+ */
+struct noise_hierarchy_t
+  : boost::noncopyable
+{
+  noise_hierarchy_t(real_t radius, std::size_t max_level, bool batch_kernel = PLANET_CORE_BATCH_NOISE_KERNEL);
+  
+  ///Whether the stacks evaluate through @c ridged_multi_kernel_t
+  bool batch_kernel() const;
+  
+  ///Not thread safe; use a @c noise_context_t to evaluate from several threads
+  noise_stack_t& get(std::size_t level);
+  
+private:
+  friend struct noise_context_t;
+  
+  const real_t radius;
+  const std::size_t max_level;
+  ///noisepp's gradient table, if the stacks use the kernel
+  boost::scoped_ptr<const gradient_table_t> gradients;
+  
+  ///Guards building the stacks and their cache pools; never held while evaluating
+  boost::mutex mutex;
+  boost::ptr_vector<noise_stack_t> stacks;
+};
+
+/**
+ * One thread's handle on a @c noise_hierarchy_t.
+ * 
+ * Holds a noisepp cache per level, taken lazily from the level's pool, and
+ * remembers the stacks it has seen; only the first evaluation of each level
+ * takes the hierarchy's lock. Several contexts may evaluate the same level
+ * at once.
+ */
+struct noise_context_t
+  : boost::noncopyable
+{
+  explicit noise_context_t(noise_hierarchy_t& hierarchy);
+  ///Returns the caches to their pools
+  ~noise_context_t();
+  
+  void evaluate(std::size_t level, noise_batch_t& batch);
+  
+private:
+  struct entry_t
+  {
+    entry_t();
+    
+    noise_stack_t* stack;
+    noisepp::Cache* cache;
+  };
+  
+  noise_hierarchy_t& hierarchy;
+  std::vector<entry_t> entries;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_NOISE_STACK_H
@@ -0,0 +1,1032 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "planet.h"
+
+#include "logic_utility.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+
+#include <boost/assert.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/tuple/tuple.hpp>
+
+namespace planet_core
+{
+
+planet_listener_t::~planet_listener_t()
+{
+
+}
+
+
+lod_view_t::lod_view_t(const vector3_t& camera_position, real_t scale, real_t fov_y, real_t viewport_height)
+  : camera_position(camera_position)
+  , scale(scale)
+  , fov_y(fov_y)
+  , viewport_height(viewport_height)
+{
+  BOOST_ASSERT(fov_y > 0);
+}
+
+real_t lod_view_t::projection() const
+{
+  return viewport_height / (real_t(2) * std::tan(fov_y / real_t(2)));
+}
+
+
+planet_t::planet_t(real_t radius, std::size_t max_level, const tile_layout_t& layout, planet_listener_t* listener,
+                   std::size_t worker_count)
+  : radius(radius)
+  , max_level(max_level < quad_key_t::MAX_LEVEL ? max_level : std::size_t(quad_key_t::MAX_LEVEL))
+  , layout(layout)
+  , listener(listener)
+  , lod_near_distance(real_t(1.1) / std::pow(real_t(2), real_t(this->max_level) - real_t(13)))
+  , lod_morph_start(real_t(.7))
+  , mpixel_tolerance(1)
+  , mmerge_tolerance(real_t(.5))
+  , mmax_splits(16)
+  , mmax_merges(16)
+  , noise_hierarchy(radius, this->max_level)
+  , noise_slab(layout.noise_width * layout.noise_height)
+  , mnodes()
+  , generator(this->layout, radius, noise_hierarchy, noise_slab)
+  , jobs(this->layout, radius, noise_hierarchy, noise_slab, worker_count)
+  , mreclaim_budget(boost::posix_time::milliseconds(1))
+  , mmerge_grace(boost::posix_time::seconds(2))
+  , cut_valid(false)
+  , cut_camera()
+  , cut_scale(0)
+  , cut_projection(0)
+  , cut_slack(0)
+  , mlod_tests(0)
+{
+  tree::pool_allocator_t branch_allocator;
+  
+  BOOST_FOREACH(const cube::face_t& face, cube::face_t::all())
+  {
+    root_ptr_t& root_ptr = roots[face.index()];
+    
+    root_ptr.reset(new root_type(null_node_handle, branch_allocator));
+    
+    initialize_root(*root_ptr, face);
+    
+    root_ptr->split();
+    
+    BOOST_FOREACH(tree_type& child, root_ptr->children())
+    {
+      initialize_tree(child);
+    }
+    
+    ///Something has to be visible from the first frame, so these are generated synchronously
+    BOOST_FOREACH(tree_type& child, root_ptr->children())
+    {
+      generate_tile(child);
+      
+      mvisibles.push_back(&child);
+      mnodes.set(child.value(), node_store_t::VISIBLE);
+    }
+  }
+}
+
+planet_t::~planet_t()
+{
+  ///Only the tree's memory is left to free; the node store takes the nodes with it
+  while (!reclaim_queue.empty())
+  {
+    tree_type* brood = reclaim_queue.back();
+    reclaim_queue.pop_back();
+    
+    tree_type::release_brood(brood, roots[0]->allocator(), reclaim_queue);
+  }
+}
+
+const planet_t::visibles_t& planet_t::visibles() const
+{
+  return mvisibles;
+}
+
+const planet_t::root_type& planet_t::root(const cube::face_t& face) const
+{
+  BOOST_ASSERT(!!roots[face.index()]);
+  return *roots[face.index()];
+}
+
+const planet_t::tree_type* planet_t::find(const quad_key_t& key) const
+{
+  const tree_type* tree = roots[key.face_index()].get();
+  
+  BOOST_ASSERT(tree);
+  
+  for (std::size_t level = key.level(); level > 0; --level)
+  {
+    if (!tree->has_children())
+      return NULL;
+    
+    ///Two bits of the Morton code per level, the first step in the top ones
+    tree = &tree->child(square::corner_t::get((key.morton() >> (2 * (level - 1))) & 3));
+  }
+  
+  return tree;
+}
+
+planet_t::tree_type* planet_t::find(const quad_key_t& key)
+{
+  return const_cast<tree_type*>(static_cast<const planet_t&>(*this).find(key));
+}
+
+void planet_t::set_reclaim_budget(const boost::posix_time::time_duration& budget)
+{
+  mreclaim_budget = budget;
+}
+
+const boost::posix_time::time_duration& planet_t::reclaim_budget() const
+{
+  return mreclaim_budget;
+}
+
+void planet_t::set_pixel_tolerance(real_t pixels)
+{
+  BOOST_ASSERT(pixels > 0);
+  mpixel_tolerance = pixels;
+  cut_valid = false;
+}
+
+real_t planet_t::pixel_tolerance() const
+{
+  return mpixel_tolerance;
+}
+
+void planet_t::set_merge_tolerance(real_t pixels)
+{
+  BOOST_ASSERT(pixels > 0);
+  mmerge_tolerance = pixels;
+  cut_valid = false;
+}
+
+real_t planet_t::merge_tolerance() const
+{
+  return mmerge_tolerance;
+}
+
+void planet_t::set_max_splits(std::size_t splits)
+{
+  BOOST_ASSERT(splits > 0);
+  mmax_splits = splits;
+}
+
+std::size_t planet_t::max_splits() const
+{
+  return mmax_splits;
+}
+
+void planet_t::set_max_merges(std::size_t merges)
+{
+  BOOST_ASSERT(merges > 0);
+  mmax_merges = merges;
+}
+
+std::size_t planet_t::max_merges() const
+{
+  return mmax_merges;
+}
+
+void planet_t::set_merge_grace(const boost::posix_time::time_duration& grace)
+{
+  mmerge_grace = grace;
+}
+
+const boost::posix_time::time_duration& planet_t::merge_grace() const
+{
+  return mmerge_grace;
+}
+
+std::size_t planet_t::pending_reclaims() const
+{
+  return reclaim_queue.size();
+}
+
+node_store_t& planet_t::nodes()
+{
+  return mnodes;
+}
+
+const node_store_t& planet_t::nodes() const
+{
+  return mnodes;
+}
+
+node_handle_t planet_t::create_node(const quad_key_t& key, real_t height_min, real_t height_max, real_t error)
+{
+  return mnodes.create(key, compute_node_bounds(key, radius, height_min, height_max), error);
+}
+
+void planet_t::initialize_root(tree_type& tree, const cube::face_t& face)
+{
+  BOOST_ASSERT(!tree.value());
+  
+  node_handle_t node = tree.value() = create_node(quad_key_t::root(face), 0, 0, 0);
+  
+  ///Roots only carry noise for their children to refine; they are never rendered
+  boost::scoped_ptr<tile_t>& tile = mnodes.tile(node);
+  tile.reset(new tile_t);
+  generator.generate_root_noise(mnodes.key(node), *tile);
+  generator.generate_bounds(mnodes.key(node), *tile);
+  mnodes.set_bounds(node, tile->bounds);
+  mnodes.set_error(node, tile->error);
+  mnodes.set(node, node_store_t::TILE_READY);
+}
+
+void planet_t::initialize_tree(tree_type& tree)
+{
+  BOOST_ASSERT(!tree.value());
+  BOOST_ASSERT(!tree.is_root());
+  BOOST_ASSERT(tree.is_child());
+  BOOST_ASSERT(tree.parent());
+  
+  const tree_type& parent = *tree.parent();
+  
+  node_handle_t parent_node = parent.value();
+  
+  ///Until its own tile is in, the child is assumed to span its parent's heights, with half its parent's error as the noise's amplitude halves per level
+  tree.value() = create_node(mnodes.key(parent_node).child(tree.corner()),
+                             mnodes.height_min(parent_node), mnodes.height_max(parent_node),
+                             mnodes.error(parent_node) / real_t(2));
+  
+  BOOST_ASSERT(mnodes.key(tree.value()).level() == tree.level());
+}
+
+void planet_t::generate_tile(tree_type& tree)
+{
+  node_handle_t node = tree.value();
+  node_handle_t parent_node = tree.parent()->value();
+  
+  BOOST_ASSERT(!mnodes.tile(node));
+  BOOST_ASSERT(!!mnodes.tile(parent_node));
+  
+  boost::scoped_ptr<tile_t>& tile = mnodes.tile(node);
+  tile.reset(new tile_t);
+  generator.generate_child_noise(mnodes.key(node), mnodes.tile(parent_node)->noise->values(), *tile);
+  generator.generate_mesh(mnodes.key(node), *tile);
+  set_tile_bounds(tree);
+  mnodes.set(node, node_store_t::TILE_READY);
+  
+  if (listener)
+    listener->tile_generated(mnodes, node);
+}
+
+void planet_t::queue_tile(tree_type& tree)
+{
+  node_handle_t node = tree.value();
+  node_handle_t parent_node = tree.parent()->value();
+  
+  BOOST_ASSERT(!mnodes.test(node, node_store_t::TILE_READY | node_store_t::TILE_QUEUED));
+  BOOST_ASSERT(!!mnodes.tile(parent_node));
+  
+  jobs.submit(boost::make_shared<tile_job_t>(node, mnodes.key(node), mnodes.tile(parent_node)->noise));
+  mnodes.set(node, node_store_t::TILE_QUEUED);
+}
+
+std::size_t planet_t::collect_tiles()
+{
+  std::vector<tile_job_pool_t::job_ptr_t> finished;
+  jobs.collect(finished);
+  
+  std::size_t collected = 0;
+  
+  BOOST_FOREACH(const tile_job_pool_t::job_ptr_t& job, finished)
+  {
+    ///The node was joined away meanwhile: released already, or detached and waiting to be
+    if (!mnodes.alive(job->node))
+      continue;
+    
+    const tree_type* tree = find(job->key);
+    
+    if (!tree || tree->value() != job->node)
+      continue;
+    
+    node_handle_t node = job->node;
+    
+    BOOST_ASSERT(!!job->tile);
+    BOOST_ASSERT(!mnodes.tile(node));
+    BOOST_ASSERT(mnodes.test(node, node_store_t::TILE_QUEUED));
+    
+    mnodes.tile(node).swap(job->tile);
+    set_tile_bounds(*tree);
+    mnodes.clear(node, node_store_t::TILE_QUEUED);
+    mnodes.set(node, node_store_t::TILE_READY);
+    
+    ++collected;
+    
+    if (listener)
+      listener->tile_generated(mnodes, node);
+  }
+  
+  return collected;
+}
+
+void planet_t::set_tile_bounds(const tree_type& tree)
+{
+  node_handle_t node = tree.value();
+  
+  BOOST_ASSERT(!!mnodes.tile(node));
+  
+  const node_bounds_t& bounds = mnodes.tile(node)->bounds;
+  real_t error = mnodes.tile(node)->error;
+  mnodes.set_bounds(node, bounds);
+  mnodes.set_normal_cone(node, mnodes.tile(node)->normal_cone);
+  mnodes.set_error(node, error);
+  
+  ///A child's noise refines its parent's up or down, so ancestors are widened to keep bounding their subtrees;
+  ///drawing an ancestor instead of the child loses the child's detail, so their errors are raised to its too
+  for (const tree_type* ancestor = tree.parent(); ancestor; ancestor = ancestor->parent())
+  {
+    node_handle_t ancestor_node = ancestor->value();
+    
+    real_t height_min = std::min(mnodes.height_min(ancestor_node), bounds.height_min);
+    real_t height_max = std::max(mnodes.height_max(ancestor_node), bounds.height_max);
+    
+    bool same_bounds = height_min == mnodes.height_min(ancestor_node) && height_max == mnodes.height_max(ancestor_node);
+    bool same_error = error <= mnodes.error(ancestor_node);
+    
+    if (same_bounds && same_error)
+      break;
+    
+    if (!same_bounds)
+      mnodes.set_bounds(ancestor_node, compute_node_bounds(mnodes.key(ancestor_node), radius, height_min, height_max));
+    
+    if (!same_error)
+      mnodes.set_error(ancestor_node, error);
+    
+    ///Cached decisions of the children took the ancestor's old bounds into account
+    BOOST_FOREACH(const tree_type& child, ancestor->children())
+    {
+      mnodes.clear(child.value(), node_store_t::LOD_VALID);
+    }
+  }
+}
+
+bool planet_t::descendant_visible(const tree_type& tree) const
+{
+  BOOST_FOREACH(const tree_type& descendant, tree.pre_order_traversal())
+  {
+    if (&descendant != &tree && mnodes.test(descendant.value(), node_store_t::VISIBLE))
+      return true;
+  }
+  
+  return false;
+}
+
+void planet_t::join(tree_type& tree)
+{
+  BOOST_ASSERT(!descendant_visible(tree));
+  
+  ///Tiles still queued for the subtree would be generated only to be thrown away by collect_tiles()
+  std::vector<node_handle_t> queued;
+  
+  BOOST_FOREACH(const tree_type& descendant, tree.pre_order_traversal())
+  {
+    if (&descendant != &tree && mnodes.test(descendant.value(), node_store_t::TILE_QUEUED))
+      queued.push_back(descendant.value());
+  }
+  
+  std::sort(queued.begin(), queued.end());
+  jobs.cancel(queued);
+  
+  ///Out of the cut and the tree right away; the nodes themselves go in reclaim()
+  if (tree_type* brood = tree.detach())
+    reclaim_queue.push_back(brood);
+}
+
+void planet_t::reclaim()
+{
+  if (reclaim_queue.empty())
+    return;
+  
+  using boost::posix_time::microsec_clock;
+  
+  boost::posix_time::ptime start = microsec_clock::universal_time();
+  
+  do
+  {
+    ///Last in first out, so a subtree is finished before the next is started, and the queue stays short
+    tree_type* brood = reclaim_queue.back();
+    reclaim_queue.pop_back();
+    
+    for (std::size_t i = 0; i < square::corner_t::SIZE; ++i)
+    {
+      node_handle_t node = brood[i].value();
+      
+      if (listener)
+        listener->tile_released(mnodes, node);
+      
+      mnodes.destroy(node);
+    }
+    
+    tree_type::release_brood(brood, roots[0]->allocator(), reclaim_queue);
+    
+  } while (!reclaim_queue.empty() && microsec_clock::universal_time() - start < mreclaim_budget);
+}
+
+bool planet_t::children_ready(const tree_type& tree) const
+{
+  BOOST_ASSERT(tree.has_children());
+  
+  BOOST_FOREACH(const tree_type& child, tree.children())
+  {
+    if (!mnodes.test(child.value(), node_store_t::TILE_READY))
+      return false;
+  }
+  
+  return true;
+}
+
+void planet_t::update_cut(const lod_view_t& view)
+{
+  std::size_t collected = collect_tiles();
+  
+  bool same_scale = cut_valid && view.scale == cut_scale && view.projection() == cut_projection;
+  real_t moved = view.camera_position.distance(cut_camera);
+  
+  mlod_tests = 0;
+  
+  ///Nothing arrived that a waiting split could use, and no decision can have changed
+  if (!collected && same_scale && moved < cut_slack)
+  {
+    expire_merges();
+    reclaim();
+    return;
+  }
+  
+  cut_valid = true;
+  cut_camera = view.camera_position;
+  cut_scale = view.scale;
+  cut_projection = view.projection();
+  cut_slack = std::numeric_limits<real_t>::max();
+  
+  ///Parents some visible wants merged into, and visibles that want splitting (or have their children ready to show)
+  std::vector<lod_change_t> merges;
+  std::vector<lod_change_t> splits;
+  std::set<tree_type*> merge_parents;
+  
+  BOOST_FOREACH(tree_type* visible, mvisibles)
+  {
+    BOOST_ASSERT(visible);
+    BOOST_ASSERT(!visible->is_root());
+    
+    tree_type* parent = visible->parent();
+    BOOST_ASSERT(parent);
+    
+    node_handle_t node = visible->value();
+    
+    bool parent_mergeable = false;
+    bool acceptable_error;
+    
+    real_t node_moved = same_scale && mnodes.test(node, node_store_t::LOD_VALID)
+                      ? view.camera_position.distance(mnodes.lod_anchor(node))
+                      : std::numeric_limits<real_t>::max();
+    
+    if (node_moved < mnodes.lod_slack(node))
+    {
+      ///Decisions are only cached while the parent is not mergeable, so it still isn't
+      acceptable_error = mnodes.test(node, node_store_t::LOD_ACCEPTABLE);
+      cut_slack = std::min(cut_slack, mnodes.lod_slack(node) - node_moved);
+    } else {
+      real_t slack;
+      real_t parent_slack = std::numeric_limits<real_t>::max();
+      
+      acceptable_error = within_pixel_error(*visible, view, mpixel_tolerance, slack);
+      mlod_tests += 1;
+      
+      ///A parent nearer than the node can find its error acceptable when the node's is not; the cut never coarsens past a node that needs refining
+      if (!parent->is_root() && acceptable_error)
+      {
+        parent_mergeable = within_pixel_error(*parent, view, mmerge_tolerance, parent_slack);
+        mlod_tests += 1;
+      }
+      
+      BOOST_ASSERT(lif(parent_mergeable, acceptable_error));
+      
+      if (!parent_mergeable)
+      {
+        slack = std::min(slack, parent_slack);
+        mnodes.set_lod(node, acceptable_error, view.camera_position, slack);
+        cut_slack = std::min(cut_slack, slack);
+      }
+    }
+    
+    if (parent_mergeable)
+    {
+      if (merge_parents.insert(parent).second)
+        merges.push_back(lod_change_t(parent, projected_pixel_error(*parent, view),
+                                      surface_distance(parent->value(), view)));
+    } else if ( acceptable_error ) {
+      ///Let things stay the same; children queued for a split no longer wanted go once their grace is over
+      begin_merge_grace(*visible);
+    } else if (visible->level() < max_level && mnodes.test(node, node_store_t::TILE_READY)) {
+      ///Children still being generated keep the node visible; they need no scheduling until they are ready
+      if (!visible->has_children() || children_ready(*visible))
+        splits.push_back(lod_change_t(visible, projected_pixel_error(*visible, view),
+                                      surface_distance(node, view)));
+    }
+  }
+  
+  ///Changes past the per call limits are still wanted, and visibles added here have not been looked at
+  bool look_again = false;
+  
+  ///The most needed detail goes first
+  std::sort(splits.begin(), splits.end(), &split_before);
+  
+  std::size_t applied = 0;
+  
+  for (std::size_t i = 0; i < splits.size(); ++i)
+  {
+    tree_type& visible = *splits[i].tree;
+    node_handle_t node = visible.value();
+    
+    ///Split already as a neighbor of another
+    if (!mnodes.test(node, node_store_t::VISIBLE))
+      continue;
+    
+    if (applied == mmax_splits)
+    {
+      look_again = true;
+      break;
+    }
+    
+    ++applied;
+    
+    if (split_visible(visible))
+      look_again = true;
+  }
+  
+  ///Keep the cut 2:1 balanced, whatever the errors: a visible more than a level coarser than a neighbor splits
+  std::set<tree_type*> unbalanced;
+  
+  BOOST_FOREACH(tree_type* visible, mvisibles)
+  {
+    const quad_key_t& key = mnodes.key(visible->value());
+    
+    BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+    {
+      tree_type* coarse = covering_visible(adjacent_key(key, direction));
+      
+      if (coarse && coarse->level() + 1 < visible->level())
+        unbalanced.insert(coarse);
+    }
+  }
+  
+  ///Not subject to the split limit, as cracks open until they are done
+  BOOST_FOREACH(tree_type* coarse, unbalanced)
+  {
+    ///Split meanwhile, as a neighbor of another
+    if (!mnodes.test(coarse->value(), node_store_t::VISIBLE))
+      continue;
+    
+    if (mnodes.test(coarse->value(), node_store_t::TILE_READY) && split_visible(*coarse))
+      look_again = true;
+  }
+  
+  /**
+   * Merges go last, so they see every split above: a parent next to a node
+   * that just split (or next to a neighbor that split on its behalf) is left
+   * alone by balanced_merge(), rather than merged now and split again next
+   * call, over and over.
+   * 
+   * The least needed detail goes first.
+   */
+  std::sort(merges.begin(), merges.end(), &merge_before);
+  
+  std::size_t merged = 0;
+  
+  for (std::size_t i = 0; i < merges.size(); ++i)
+  {
+    tree_type& parent = *merges[i].tree;
+    
+    ///Waits for its finer neighbors to merge first; not counted, or parents held back like this could use up the limit every call
+    if (!balanced_merge(parent))
+      continue;
+    
+    if (merged == mmax_merges)
+    {
+      look_again = true;
+      break;
+    }
+    
+    ++merged;
+    look_again = true;
+    
+    ///Add the parent to visibles, in place of its children
+    if (!mnodes.test(parent.value(), node_store_t::VISIBLE))
+    {
+      mvisibles.push_back(&parent);
+      mnodes.set(parent.value(), node_store_t::VISIBLE);
+    }
+    
+    BOOST_FOREACH(tree_type& child, parent.children())
+    {
+      if (!mnodes.test(child.value(), node_store_t::VISIBLE))
+        continue;
+      
+      mvisibles.get<1>().erase(&child);
+      mnodes.clear(child.value(), node_store_t::VISIBLE);
+    }
+    
+    begin_merge_grace(parent);
+  }
+  
+  if (look_again)
+    cut_slack = 0;
+  
+  expire_merges();
+  reclaim();
+  
+#ifndef NDEBUG
+  std::set<tree_type*> debug_unique_visibles;
+  
+  BOOST_FOREACH(tree_type* visible, mvisibles)
+  {
+    BOOST_ASSERT(debug_unique_visibles.find(visible) == debug_unique_visibles.end());
+    BOOST_ASSERT(mnodes.test(visible->value(), node_store_t::VISIBLE));
+    debug_unique_visibles.insert(visible);
+  }
+#endif
+}
+
+bool planet_t::split_visible(tree_type& visible)
+{
+  node_handle_t node = visible.value();
+  
+  BOOST_ASSERT(mnodes.test(node, node_store_t::VISIBLE));
+  BOOST_ASSERT(mnodes.test(node, node_store_t::TILE_READY));
+  
+  if (!visible.has_children())
+  {
+    ///Create children for visible, and have their tiles generated in the background; visible stays until they are ready
+    visible.split();
+    BOOST_FOREACH(tree_type& child, visible.children())
+    {
+      initialize_tree(child);
+      queue_tile(child);
+    }
+    
+    return false;
+  }
+  
+  ///Stays until all of its children can be drawn
+  if (!children_ready(visible))
+    return false;
+  
+  ///Its children would be two levels finer than a neighbor: that one splits first, so no crack opens meanwhile
+  ///(a copy, as splitting neighbors adds nodes to the store)
+  const quad_key_t key = mnodes.key(node);
+  bool coarser_neighbor = false;
+  
+  BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+  {
+    tree_type* neighbor = covering_visible(adjacent_key(key, direction));
+    
+    if (!neighbor || neighbor->level() >= visible.level())
+      continue;
+    
+    if (mnodes.test(neighbor->value(), node_store_t::TILE_READY))
+      split_visible(*neighbor);
+    
+    ///Its children are not ready yet, or it waits on coarser neighbors of its own
+    if (mnodes.test(neighbor->value(), node_store_t::VISIBLE))
+      coarser_neighbor = true;
+  }
+  
+  ///Split once the neighbors are; left for a later call, they could be merged back before it comes
+  if (coarser_neighbor)
+    return true;
+  
+  ///Replace visible with its children; a subtree kept from a merge is taken back as is
+  BOOST_FOREACH(tree_type& child, visible.children())
+  {
+    mvisibles.push_back(&child);
+    mnodes.set(child.value(), node_store_t::VISIBLE);
+  }
+  
+  mvisibles.get<1>().erase(&visible);
+  mnodes.clear(node, node_store_t::VISIBLE | node_store_t::MERGE_GRACE);
+  
+  return true;
+}
+
+bool planet_t::balanced_merge(const tree_type& parent) const
+{
+  BOOST_FOREACH(const tree_type& child, parent.children())
+  {
+    const quad_key_t& key = mnodes.key(child.value());
+    
+    ///Drawn finer than the child (siblings included), the region would end up two levels finer than the parent
+    BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+    {
+      if (!covering_visible(adjacent_key(key, direction)))
+        return false;
+    }
+  }
+  
+  return true;
+}
+
+const planet_t::tree_type* planet_t::covering_visible(const quad_key_t& key) const
+{
+  const tree_type* tree = roots[key.face_index()].get();
+  
+  BOOST_ASSERT(tree);
+  
+  for (std::size_t level = key.level(); ; --level)
+  {
+    if (mnodes.test(tree->value(), node_store_t::VISIBLE))
+      return tree;
+    
+    if (level == 0 || !tree->has_children())
+      return NULL;
+    
+    tree = &tree->child(square::corner_t::get((key.morton() >> (2 * (level - 1))) & 3));
+  }
+}
+
+planet_t::tree_type* planet_t::covering_visible(const quad_key_t& key)
+{
+  return const_cast<tree_type*>(static_cast<const planet_t&>(*this).covering_visible(key));
+}
+
+boost::uint8_t planet_t::coarser_edges(const tree_type& visible) const
+{
+  const quad_key_t& key = mnodes.key(visible.value());
+  
+  boost::uint8_t result = 0;
+  
+  BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+  {
+    const tree_type* neighbor = covering_visible(adjacent_key(key, direction));
+    
+    if (neighbor && neighbor->level() < visible.level())
+      result |= boost::uint8_t(1 << direction.index());
+  }
+  
+  return result;
+}
+
+bool planet_t::split_before(const lod_change_t& lhs, const lod_change_t& rhs)
+{
+  if (lhs.pixels != rhs.pixels)
+    return lhs.pixels > rhs.pixels;
+  return lhs.distance < rhs.distance;
+}
+
+bool planet_t::merge_before(const lod_change_t& lhs, const lod_change_t& rhs)
+{
+  if (lhs.pixels != rhs.pixels)
+    return lhs.pixels < rhs.pixels;
+  return lhs.distance > rhs.distance;
+}
+
+void planet_t::begin_merge_grace(tree_type& tree)
+{
+  node_handle_t node = tree.value();
+  
+  if (!tree.has_children() || mnodes.test(node, node_store_t::MERGE_GRACE))
+    return;
+  
+  mnodes.set(node, node_store_t::MERGE_GRACE);
+  
+  using boost::posix_time::microsec_clock;
+  merge_graces.push_back(grace_entry_t(node, mnodes.key(node), microsec_clock::universal_time() + mmerge_grace));
+}
+
+void planet_t::expire_merges()
+{
+  using boost::posix_time::microsec_clock;
+  
+  boost::posix_time::ptime now = microsec_clock::universal_time();
+  
+  while (!merge_graces.empty() && merge_graces.front().get<2>() <= now)
+  {
+    node_handle_t node = merge_graces.front().get<0>();
+    quad_key_t key = merge_graces.front().get<1>();
+    merge_graces.pop_front();
+    
+    ///Released since, or split again and its subtree taken back
+    if (!mnodes.alive(node) || !mnodes.test(node, node_store_t::MERGE_GRACE))
+      continue;
+    
+    mnodes.clear(node, node_store_t::MERGE_GRACE);
+    
+    tree_type* found = find(key);
+    
+    ///Detached with an ancestor's subtree, waiting to be released
+    if (!found || found->value() != node)
+      continue;
+    
+    tree_type& tree = *found;
+    
+    ///Merged further up meanwhile, so its ancestor's grace covers it; or not yet done merging
+    if (!mnodes.test(node, node_store_t::VISIBLE) || !tree.has_children() || descendant_visible(tree))
+      continue;
+    
+    join(tree);
+  }
+}
+
+std::size_t planet_t::lod_tests() const
+{
+  return mlod_tests;
+}
+
+void planet_t::cull(const frustum_t& frustum, const vector3_t& camera_position, std::vector<node_handle_t>& result) const
+{
+  cull(frustum, camera_position, std::numeric_limits<std::size_t>::max(), result);
+}
+
+void planet_t::cull(const frustum_t& frustum, const vector3_t& camera_position, std::size_t max_level,
+                    std::vector<node_handle_t>& result) const
+{
+  ///Planes still to test, and whether the horizon still has to be
+  typedef boost::tuple<const tree_type*, plane_mask_t, bool> entry_t;
+  
+  ///Root bounds cover their whole face, so the lowest root bounds all terrain
+  real_t lowest = 0;
+  
+  for (std::size_t face = 0; face < roots.size(); ++face)
+  {
+    lowest = std::min(lowest, mnodes.height_min(roots[face]->value()));
+  }
+  
+  horizon_t horizon(camera_position, radius + lowest);
+  
+  std::vector<entry_t> stack;
+  
+  for (std::size_t face = 0; face < roots.size(); ++face)
+  {
+    stack.push_back(entry_t(roots[face].get(), frustum.active, true));
+  }
+  
+  while (!stack.empty())
+  {
+    const tree_type& tree = *stack.back().get<0>();
+    plane_mask_t mask = stack.back().get<1>();
+    bool test_horizon = stack.back().get<2>();
+    stack.pop_back();
+    
+    node_handle_t node = tree.value();
+    
+    ///Bounds cover the whole subtree, so a node out of view takes its subtree with it
+    if (classify(frustum, mnodes.box(node), mask) == OUTSIDE)
+      continue;
+    
+    if (test_horizon)
+    {
+      const vector3_t& direction = mnodes.direction(node);
+      real_t angular_radius = mnodes.angular_radius(node);
+      
+      if (horizon.hides(direction, angular_radius, radius + mnodes.height_max(node)))
+        continue;
+      
+      test_horizon = !horizon.reveals(direction, angular_radius, radius + mnodes.height_min(node));
+    }
+    
+    ///An ancestor of visibles keeps its tile, so it can stand in for them
+    bool coarsened = mnodes.key(node).level() >= max_level && mnodes.test(node, node_store_t::TILE_READY);
+    
+    if (mnodes.test(node, node_store_t::VISIBLE) || coarsened)
+    {
+      ///Only what is drawn has a meaningful normal cone; a parent's does not bound its children's
+      if (!back_facing(mnodes.normal_cone(node), mnodes.center(node), mnodes.radius(node), camera_position))
+        result.push_back(node);
+      
+      continue;
+    }
+    
+    ///Children of a node inside every plane, and above the horizon, are accepted without tests
+    BOOST_FOREACH(const tree_type& child, tree.children())
+    {
+      stack.push_back(entry_t(&child, mask, test_horizon));
+    }
+  }
+}
+
+bool planet_t::acceptable_pixel_error(const tree_type& tree, const lod_view_t& view) const
+{
+  real_t slack;
+  return acceptable_pixel_error(tree, view, slack);
+}
+
+bool planet_t::acceptable_pixel_error(const tree_type& tree, const lod_view_t& view, real_t& slack) const
+{
+  return within_pixel_error(tree, view, mpixel_tolerance, slack);
+}
+
+real_t planet_t::projected_pixel_error(const tree_type& tree, const lod_view_t& view) const
+{
+  node_handle_t node = tree.value();
+  
+  real_t d = std::max(lod_near_distance, view.scale * surface_distance(node, view));
+  
+  return mnodes.error(node) * view.scale * view.projection() / d;
+}
+
+void planet_t::morph_range(const tree_type& visible, const lod_view_t& view, real_t& start, real_t& end) const
+{
+  const tree_type* parent = visible.parent();
+  
+  BOOST_ASSERT(parent);
+  
+  if (parent->is_root())
+  {
+    start = end = std::numeric_limits<real_t>::max();
+    return;
+  }
+  
+  ///As in within_pixel_error(), the parent's error is over the tolerance nearer than this
+  end = mnodes.error(parent->value()) * view.projection() / mpixel_tolerance;
+  start = end * lod_morph_start;
+}
+
+bool planet_t::within_pixel_error(const tree_type& tree, const lod_view_t& view, real_t tolerance, real_t& slack) const
+{
+  node_handle_t node = tree.value();
+  
+  ///Node distance from camera, planet relative; the nearest the drawn patch can be
+  real_t surface = surface_distance(node, view);
+  
+  ///Sizes and distances are measured in world units, like the camera sees them
+  real_t d = std::max(lod_near_distance, view.scale * surface);
+  
+  /**
+   * An error e seen from distance d covers about e * projection / d pixels
+   * (the scale cancels out), which is within the tolerance once d exceeds
+   * e * projection / tolerance.
+   */
+  real_t split_distance = mnodes.error(node) * view.projection() / tolerance;
+  
+  /**
+   * The result changes where the surface distance crosses the split distance.
+   * When the split distance is inside lod_near_distance the floor decides
+   * instead; the slack then also stops at the patch, so a camera landing on
+   * it has the node looked at again.
+   */
+  slack = std::abs(surface - split_distance);
+  if (view.scale * split_distance < lod_near_distance)
+    slack = std::min(slack, surface);
+  
+  return d > view.scale * split_distance;
+}
+
+real_t planet_t::surface_distance(node_handle_t node, const lod_view_t& view) const
+{
+  const vector3_t& camera = view.camera_position;
+  
+  double camera_radius = camera.length();
+  double altitude = camera_radius - double(radius);
+  
+  ///Angle from the camera's direction out to the patch's cap; from chords rather than cosines, which lose small angles to rounding
+  double outside = 0;
+  
+  if (camera_radius > 0)
+  {
+    double chord = camera.normalised().distance(mnodes.direction(node));
+    outside = 2.0 * std::asin(std::min(1.0, chord / 2.0)) - double(mnodes.angular_radius(node));
+  }
+  
+  ///Above (or below) the cap, the nearest point is straight down
+  if (outside <= 0)
+    return real_t(std::abs(altitude));
+  
+  ///Otherwise it is on the cap's rim: the law of cosines, with 1 - cos(a) as 2 * sin^2(a / 2)
+  double half_sine = std::sin(outside / 2.0);
+  
+  return real_t(std::sqrt(altitude * altitude + 4.0 * camera_radius * double(radius) * half_sine * half_sine));
+}
+
+} // namespace planet_core
@@ -0,0 +1,379 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_PLANET_H
+#define PLANET_CORE_PLANET_H
+
+#include "types.h"
+#include "quad_key.h"
+#include "node_store.h"
+#include "culling.h"
+#include "tile.h"
+#include "tile_jobs.h"
+#include "noise_stack.h"
+
+#include <tree/tree.h>
+#include <square/square.h>
+#include <cube/cube.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/multi_index/indexed_by.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index_container.hpp>
+
+#include <boost/array.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/tuple/tuple.hpp>
+
+namespace planet_core
+{
+
+///Notified by @c planet_t as tiles become available
+struct planet_listener_t
+{
+  virtual ~planet_listener_t();
+  
+  ///@c node has a complete @c tile_t (noise and mesh) in @c nodes.
+  ///Called on the thread that constructs the planet and calls @c update_cut()
+  virtual void tile_generated(node_store_t& nodes, node_handle_t node) = 0;
+  
+  ///@c node is about to be destroyed, some frames after its parent was joined; release what hangs off of it
+  virtual void tile_released(node_store_t& nodes, node_handle_t node) = 0;
+};
+
+///The camera, as seen from the planet
+struct lod_view_t
+{
+  lod_view_t(const vector3_t& camera_position, real_t scale, real_t fov_y, real_t viewport_height);
+  
+  ///Pixels covered by a unit of size seen face on from a unit of distance
+  real_t projection() const;
+  
+  ///Camera position, planet relative
+  vector3_t camera_position;
+  ///World units per planet unit
+  real_t scale;
+  ///Vertical field of view, radians
+  real_t fov_y;
+  ///Pixels
+  real_t viewport_height;
+};
+
+///The quadtrees of the six cube faces, and the current cut through them
+struct planet_t
+  : boost::noncopyable
+{
+  ///The tree only holds handles; the nodes themselves live in the @c node_store_t
+  ///Four siblings are one block from a pool shared by all six faces, so splits and joins don't hit the heap
+  ///Only the level, read by every LOD walk, is stored; the root (needed by splits) and the corner are derived
+  typedef tree::node_fields_t<tree::stored_level_t, tree::climbing_root_t, tree::implicit_corner_t> tree_fields_t;
+  typedef tree::root_t<node_handle_t, 4, square::corner_t, tree::pool_allocator_t,
+                       tree::no_adjacency_t, tree_fields_t> root_type;
+  typedef tree::branch_t<node_handle_t, 4, square::corner_t, tree::pool_allocator_t,
+                         tree::no_adjacency_t, tree_fields_t> tree_type;
+  
+  typedef boost::multi_index_container<
+    tree_type*,
+    boost::multi_index::indexed_by<
+      boost::multi_index::sequenced<>, // list-like index
+      boost::multi_index::ordered_unique< boost::multi_index::identity<tree_type*> > // set like
+    >
+  > visibles_t;
+  
+  /**
+   * @param max_level clamped to @c quad_key_t::MAX_LEVEL
+   * @param listener may be NULL, e.g. when running headless
+   * @param worker_count threads generating child tiles; with 0 they are
+   *  generated inside @c update_cut()
+   */
+  planet_t(real_t radius, std::size_t max_level, const tile_layout_t& layout, planet_listener_t* listener = NULL,
+           std::size_t worker_count = tile_job_pool_t::default_worker_count());
+  ~planet_t();
+  
+  /**
+   * Refine/coarsen the @c visibles cut for @c view.
+   * 
+   * A node whose error exceeds the pixel tolerance splits: it queues its
+   * children on the worker pool and stays visible until all four children's
+   * tiles have arrived. Children merge back into their parent only once its
+   * error is within the (lower) merge tolerance, so a camera between the
+   * two leaves the cut alone. At most @c max_splits() splits and
+   * @c max_merges() merges are made per call, those with the largest
+   * (respectively smallest) screen-space error first, then the nearest
+   * (farthest); the rest are made by later calls.
+   * 
+   * The cut is kept 2:1 balanced, across cube faces too: a visible more
+   * than a level coarser than a neighbor is split whatever its error (and
+   * past the split limit), and children don't merge while that would leave
+   * their parent so coarse. Merges are made after the splits, so a neighbor
+   * split to let a node split stays split.
+   * 
+   * A merged node keeps its subtree for @c merge_grace(), so splitting it
+   * again meanwhile costs nothing; after that, unless it split again, its
+   * subtree is unhooked and released over this and later calls, within the
+   * reclaim budget.
+   * 
+   * Each visible's decision is cached with the camera position it was made
+   * at, and how far the camera can move before it might change; only nodes
+   * the camera has moved out of that range of are tested again. If no tile
+   * arrived and the camera stayed within range of every visible, the cut is
+   * left alone without looking at it.
+   */
+  void update_cut(const lod_view_t& view);
+  
+  ///Nodes whose error the last @c update_cut() computed, rather than took from the cache
+  std::size_t lod_tests() const;
+  
+  ///Time @c update_cut() may spend releasing joined subtrees; at least one brood is released per call
+  void set_reclaim_budget(const boost::posix_time::time_duration& budget);
+  const boost::posix_time::time_duration& reclaim_budget() const;
+  
+  ///Broods of joined subtrees still waiting to be released
+  std::size_t pending_reclaims() const;
+  
+  ///Pixels a node's geometric error may project to before it is split; 1 by default
+  void set_pixel_tolerance(real_t pixels);
+  real_t pixel_tolerance() const;
+  
+  ///Pixels a parent's error must project within before its children merge back into it; half a pixel by default.
+  ///Keep it below the pixel tolerance, or nodes near the threshold split and merge on alternate calls
+  void set_merge_tolerance(real_t pixels);
+  real_t merge_tolerance() const;
+  
+  ///Splits (including starting a split's tile generation) @c update_cut() makes per call; 16 by default
+  void set_max_splits(std::size_t splits);
+  std::size_t max_splits() const;
+  
+  ///Merges @c update_cut() makes per call; 16 by default
+  void set_max_merges(std::size_t merges);
+  std::size_t max_merges() const;
+  
+  ///How long a merged node keeps its subtree; 2 seconds by default
+  void set_merge_grace(const boost::posix_time::time_duration& grace);
+  const boost::posix_time::time_duration& merge_grace() const;
+  
+  /**
+   * Whether the node's geometric error, projected to the screen from the
+   * node's distance, is within the pixel tolerance. The distance is to the
+   * drawn patch, which is not displaced, not to the bounds; nearer than
+   * @c lod_near_distance it is taken to be that.
+   */
+  bool acceptable_pixel_error(const tree_type& tree, const lod_view_t& view) const;
+  
+  /**
+   * @param slack set to how far (planet relative) the camera can move before
+   *  the result might change
+   */
+  bool acceptable_pixel_error(const tree_type& tree, const lod_view_t& view, real_t& slack) const;
+  
+  ///Pixels the node's geometric error covers, seen from @c view
+  real_t projected_pixel_error(const tree_type& tree, const lod_view_t& view) const;
+  
+  /**
+   * Camera distances (planet relative) over which @c visible morphs into
+   * its parent's mesh (see @c generate_morph_targets()): not at all up to
+   * @c start, entirely from @c end on. @c end is where its parent splits, so
+   * the split, and a merge anywhere past it, doesn't pop.
+   * 
+   * Children of a root have no coarser mesh; both are then the largest real_t.
+   */
+  void morph_range(const tree_type& visible, const lod_view_t& view, real_t& start, real_t& end) const;
+  
+  const visibles_t& visibles() const;
+  
+  /**
+   * Append the visibles that may be seen from @c camera_position through
+   * @c frustum to @c result: those whose bounds intersect the frustum and
+   * rise above the planet's horizon, and whose mesh is not wholly back facing.
+   * 
+   * Walks down from the six roots: a subtree out of view is skipped
+   * without being visited, and planes (or the horizon) a subtree is wholly
+   * inside of are not tested again below it.
+   */
+  void cull(const frustum_t& frustum, const vector3_t& camera_position, std::vector<node_handle_t>& result) const;
+  
+  /**
+   * As above, but the cut is coarsened to @c max_level: where visibles lie
+   * deeper, their ancestor at @c max_level is appended in their place. Meant
+   * for secondary views (shadow, reflection cameras) that reuse the cut
+   * @c update_cut() made for the main camera, but need less detail; the cut
+   * itself is left alone.
+   */
+  void cull(const frustum_t& frustum, const vector3_t& camera_position, std::size_t max_level,
+            std::vector<node_handle_t>& result) const;
+  
+  /**
+   * Edges of @c visible whose neighbor is drawn coarser: bit
+   * @c direction.index() for each @c square::direction_t, across cube faces
+   * too. The cut is kept 2:1 balanced, so that is one level coarser but for
+   * a few calls while a split is under way. See @c generate_tile_indices().
+   * 
+   * Also good for a node drawn in place of the visibles below it (see
+   * @c cull()): where the cut is finer than it, its neighbors are drawn at
+   * its level too.
+   */
+  boost::uint8_t coarser_edges(const tree_type& visible) const;
+  
+  const root_type& root(const cube::face_t& face) const;
+  
+  ///The node named by @c key, if it is in the tree; O(level)
+  const tree_type* find(const quad_key_t& key) const;
+  tree_type* find(const quad_key_t& key);
+  
+  node_store_t& nodes();
+  const node_store_t& nodes() const;
+  
+public:
+  const real_t radius;
+  const std::size_t max_level;
+  const tile_layout_t layout;
+private:
+  ///A split or merge @c update_cut() wants to make
+  struct lod_change_t
+  {
+    lod_change_t(tree_type* tree, real_t pixels, real_t distance)
+      : tree(tree)
+      , pixels(pixels)
+      , distance(distance)
+    {}
+    
+    ///The node to split, or the parent to merge into
+    tree_type* tree;
+    ///Screen-space error of @c tree
+    real_t pixels;
+    ///Of @c tree from the camera, planet relative
+    real_t distance;
+  };
+  
+  static bool split_before(const lod_change_t& lhs, const lod_change_t& rhs);
+  static bool merge_before(const lod_change_t& lhs, const lod_change_t& rhs);
+  
+  /**
+   * Start splitting @c visible (with its tile ready), or replace it by its
+   * children once they are ready and no neighbor is coarser than it;
+   * coarser neighbors are split first, in the same call where they can be.
+   * 
+   * @return whether the cut changed, or has to be looked at again for the split to go on
+   */
+  bool split_visible(tree_type& visible);
+  
+  ///Whether merging into @c parent keeps the cut 2:1 balanced
+  bool balanced_merge(const tree_type& parent) const;
+  
+  ///The visible drawn over the node @c key, if it is that node or an ancestor; NULL where the cut is finer
+  const tree_type* covering_visible(const quad_key_t& key) const;
+  tree_type* covering_visible(const quad_key_t& key);
+  
+  /**
+   * Distance (planet relative) from the camera to the node's patch as drawn,
+   * on the undisplaced sphere; measured to the cap of @c angular_radius()
+   * around its @c direction(), so never more than the patch's.
+   */
+  real_t surface_distance(node_handle_t node, const lod_view_t& view) const;
+  
+  ///@c acceptable_pixel_error() against @c tolerance pixels
+  bool within_pixel_error(const tree_type& tree, const lod_view_t& view, real_t tolerance, real_t& slack) const;
+  
+  ///Add the node @c key to the store, bounded over the heights [@c height_min, @c height_max]
+  node_handle_t create_node(const quad_key_t& key, real_t height_min, real_t height_max, real_t error);
+  
+  void initialize_root(tree_type& tree, const cube::face_t& face);
+  void initialize_tree(tree_type& tree);
+  void generate_tile(tree_type& tree);
+  void queue_tile(tree_type& tree);
+  
+  ///Take the bounds, normal cone and error of the node's newly arrived tile, widening its ancestors' bounds and errors to match
+  void set_tile_bounds(const tree_type& tree);
+  
+  ///Attach the tiles the workers finished since the last call; returns how many
+  std::size_t collect_tiles();
+  bool children_ready(const tree_type& tree) const;
+  
+  ///Whether any strict descendant of @c tree is in @c visibles
+  bool descendant_visible(const tree_type& tree) const;
+  ///Detach the subtree below @c tree, and queue it for release
+  void join(tree_type& tree);
+  ///Release queued broods, until @c reclaim_budget is spent
+  void reclaim();
+  
+  ///Keep the subtree below @c tree for @c merge_grace before joining it
+  void begin_merge_grace(tree_type& tree);
+  ///Join the subtrees of merged nodes whose grace is over, and which are still merged
+  void expire_merges();
+  
+  planet_listener_t* listener;
+  
+  ///Camera distance (world units) within which every node is refined to the last level
+  const real_t lod_near_distance;
+  ///Where in the range up to its parent's split distance a node starts morphing into its parent
+  const real_t lod_morph_start;
+  real_t mpixel_tolerance;
+  real_t mmerge_tolerance;
+  std::size_t mmax_splits;
+  std::size_t mmax_merges;
+  
+  noise_hierarchy_t noise_hierarchy;
+  ///Declared before anything holding tiles, so it outlives them
+  noise_slab_t noise_slab;
+  node_store_t mnodes;
+  tile_generator_t generator;
+  
+  ///Declared after everything the workers use, so it is destroyed first
+  tile_job_pool_t jobs;
+  
+  typedef boost::scoped_ptr<root_type> root_ptr_t;
+  boost::array< root_ptr_t, 6> roots;
+  visibles_t mvisibles;
+  
+  ///Detached broods whose nodes are yet to be released; the roots' allocator must outlive them. The roots share
+  ///one pool, so any root's allocator takes a brood back
+  std::vector<tree_type*> reclaim_queue;
+  boost::posix_time::time_duration mreclaim_budget;
+  
+  ///Merged nodes (and their keys, to find them again) with when their grace is over, soonest first
+  typedef boost::tuple<node_handle_t, quad_key_t, boost::posix_time::ptime> grace_entry_t;
+  std::deque<grace_entry_t> merge_graces;
+  boost::posix_time::time_duration mmerge_grace;
+  
+  //The view the cut was last computed for, and how far the camera can move before any visible's decision might change
+  bool cut_valid;
+  vector3_t cut_camera;
+  real_t cut_scale;
+  real_t cut_projection;
+  real_t cut_slack;
+  std::size_t mlod_tests;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_PLANET_H
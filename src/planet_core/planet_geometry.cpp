@@ -0,0 +1,349 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "planet_geometry.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <boost/array.hpp>
+#include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/swap.hpp>
+
+namespace planet_core
+{
+
+vector2_t to_face_coordinates(const quad_key_t& key, const square::corner_t& corner)
+{
+  ///Scaled in double, so deep levels keep their exact grid lines until the final rounding
+  double u = key.corner_u<double>(corner);
+  double v = key.corner_v<double>(corner);
+  
+  return vector2_t(real_t(u * 2 - 1), real_t(v * 2 - 1));
+}
+
+vector3_t to_planet_relative(const quad_key_t& key, const square::corner_t& corner, real_t radius)
+{
+  return to_planet_relative(key.face(), to_face_coordinates(key, corner), radius);
+}
+
+vector3_t to_planet_relative(const cube::face_t& face, const vector2_t& uv, real_t radius)
+{
+  const cube::direction_t& direction = face.direction();
+  
+  vector3_t cube_xyz;
+  
+  boost::uint8_t axis = direction.axis();
+  
+  cube_xyz[ (axis + 0) % 3 ] = 1;
+  cube_xyz[ (axis + 1) % 3 ] = uv[0];
+  cube_xyz[ (axis + 2) % 3 ] = uv[1];
+  
+  if (!direction.positive())
+  {
+    boost::swap(cube_xyz[(axis + 1) % 3], cube_xyz[(axis + 2) % 3]);
+    cube_xyz = -cube_xyz;
+  }
+  
+  vector3_t sphere_xyz;
+  
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    real_t& x_i_p = sphere_xyz[i];
+    const real_t& x_i = cube_xyz[ (i + 0) % 3];
+    const real_t& y_i = cube_xyz[ (i + 1) % 3];
+    const real_t& z_i = cube_xyz[ (i + 2) % 3];
+    
+    x_i_p = x_i 
+          * std::sqrt(
+            real_t(1)
+          - (y_i * y_i) / real_t(2)
+          - (z_i * z_i) / real_t(2) + 
+          + ((y_i * y_i) * (z_i * z_i)) / real_t(3));
+  }
+  
+  sphere_xyz *= radius;
+  
+  return sphere_xyz;
+}
+
+namespace
+{
+  boost::array<matrix3_t, 6> create_face_rotations()
+  {
+    boost::array<matrix3_t, 6> rotations;
+    
+    ///+z: identity
+    rotations[cube::direction_t::get( 0, 0, 1).index()] = matrix3_t();
+    ///-z: PI around y
+    rotations[cube::direction_t::get( 0, 0,-1).index()] = matrix3_t(-1, 0, 0,
+                                                                      0, 1, 0,
+                                                                      0, 0,-1);
+    ///+y: PI around x
+    rotations[cube::direction_t::get( 0, 1, 0).index()] = matrix3_t( 1, 0, 0,
+                                                                      0,-1, 0,
+                                                                      0, 0,-1);
+    ///-y: -PI around x
+    rotations[cube::direction_t::get( 0,-1, 0).index()] = matrix3_t( 1, 0, 0,
+                                                                      0,-1, 0,
+                                                                      0, 0,-1);
+    ///+x: PI/2 around y
+    rotations[cube::direction_t::get( 1, 0, 0).index()] = matrix3_t( 0, 0, 1,
+                                                                      0, 1, 0,
+                                                                     -1, 0, 0);
+    ///-x: -PI/2 around y
+    rotations[cube::direction_t::get(-1, 0, 0).index()] = matrix3_t( 0, 0,-1,
+                                                                      0, 1, 0,
+                                                                      1, 0, 0);
+    return rotations;
+  }
+} // anonymous namespace
+
+const matrix3_t& face_orientation(const cube::face_t& face)
+{
+  static const boost::array<matrix3_t, 6> face_rotations = create_face_rotations();
+  
+  return face_rotations[face.direction().index()];
+}
+
+quad_key_t adjacent_key(const quad_key_t& key, const square::direction_t& direction)
+{
+  quad_key_t result;
+  
+  if (key.neighbor(direction, result))
+    return result;
+  
+  const double side = std::ldexp(1.0, int(key.level()));
+  
+  ///The neighbor's center in [-1,1] face coordinates: a cell past the face's edge
+  double u = (double(key.x()) + .5 + direction.x()) / side * 2 - 1;
+  double v = (double(key.y()) + .5 + direction.y()) / side * 2 - 1;
+  
+  ///On the cube, laid out as in to_planet_relative()
+  const cube::direction_t& face_direction = key.face().direction();
+  boost::uint8_t axis = face_direction.axis();
+  
+  boost::array<double, 3> cube_xyz;
+  cube_xyz[ (axis + 0) % 3 ] = 1;
+  cube_xyz[ (axis + 1) % 3 ] = u;
+  cube_xyz[ (axis + 2) % 3 ] = v;
+  
+  if (!face_direction.positive())
+  {
+    boost::swap(cube_xyz[(axis + 1) % 3], cube_xyz[(axis + 2) % 3]);
+    
+    for (std::size_t i = 0; i < 3; ++i)
+      cube_xyz[i] = -cube_xyz[i];
+  }
+  
+  ///Fold the overhang over the cube's edge, onto the face it ran into
+  boost::uint8_t next_axis = std::abs(cube_xyz[(axis + 1) % 3]) > 1 ? (axis + 1) % 3 : (axis + 2) % 3;
+  double overhang = std::abs(cube_xyz[next_axis]) - 1;
+  
+  BOOST_ASSERT(overhang > 0);
+  
+  cube_xyz[next_axis] = cube_xyz[next_axis] > 0 ? 1 : -1;
+  cube_xyz[axis] = cube_xyz[axis] > 0 ? 1 - overhang : overhang - 1;
+  
+  const cube::direction_t& next_direction = cube::direction_t::get(next_axis == 0 ? boost::int8_t(cube_xyz[0]) : 0,
+                                                                    next_axis == 1 ? boost::int8_t(cube_xyz[1]) : 0,
+                                                                    next_axis == 2 ? boost::int8_t(cube_xyz[2]) : 0);
+  
+  ///Back to face coordinates, undoing to_planet_relative()'s layout for the new face
+  double next_u = next_direction.positive() ?  cube_xyz[(next_axis + 1) % 3] : -cube_xyz[(next_axis + 2) % 3];
+  double next_v = next_direction.positive() ?  cube_xyz[(next_axis + 2) % 3] : -cube_xyz[(next_axis + 1) % 3];
+  
+  boost::uint32_t last = boost::uint32_t(side) - 1;
+  boost::uint32_t x = std::min(last, boost::uint32_t(std::max(0.0, std::floor((next_u + 1) / 2 * side))));
+  boost::uint32_t y = std::min(last, boost::uint32_t(std::max(0.0, std::floor((next_v + 1) / 2 * side))));
+  
+  return quad_key_t(cube::face_t::get(next_direction), key.level(),
+                    quad_key_t::spread(x) | (quad_key_t::spread(y) << 1));
+}
+
+node_bounds_t compute_node_bounds(const quad_key_t& key, real_t radius, real_t height_min, real_t height_max)
+{
+  BOOST_ASSERT(height_min <= height_max);
+  
+  ///Samples per side of the patch; the sphere bulges between them by at most the sagitta added below
+  static const std::size_t SAMPLES = 5;
+  
+  const cube::face_t& face = key.face();
+  
+  vector2_t omin = to_face_coordinates(key, square::corner_t::get(false, false));
+  vector2_t omax = to_face_coordinates(key, square::corner_t::get(true, true));
+  vector2_t omid = (omin + omax) * real_t(.5);
+  
+  ///The box's frame: the patch's normal at its center, and the face's u direction made tangent to it
+  vector3_t normal = to_planet_relative(face, omid, 1);
+  vector3_t u_direction = to_planet_relative(face, vector2_t(omax.x, omid.y), 1)
+                        - to_planet_relative(face, vector2_t(omin.x, omid.y), 1);
+  vector3_t tangent = (u_direction - normal * u_direction.dot(normal)).normalised();
+  vector3_t bitangent = normal.cross(tangent);
+  
+  node_bounds_t bounds;
+  bounds.height_min = height_min;
+  bounds.height_max = height_max;
+  
+  oriented_box_t& box = bounds.box;
+  box.axes = matrix3_t(tangent.x,   tangent.y,   tangent.z,
+                       bitangent.x, bitangent.y, bitangent.z,
+                       normal.x,    normal.y,    normal.z);
+  
+  boost::array<vector3_t, SAMPLES * SAMPLES> directions;
+  
+  for (std::size_t v = 0; v < SAMPLES; ++v)
+  {
+    for (std::size_t u = 0; u < SAMPLES; ++u)
+    {
+      vector2_t uv = omin + (omax - omin) * (vector2_t(u, v) / vector2_t(SAMPLES - 1, SAMPLES - 1));
+      directions[v * SAMPLES + u] = to_planet_relative(face, uv, 1);
+    }
+  }
+  
+  const real_t outer_radius = radius + height_max;
+  ///Terrain dug below the planet's center still lies within the patch's cone
+  const real_t shell_radii[2] = {std::max(real_t(0), radius + height_min), outer_radius};
+  
+  vector3_t lo(std::numeric_limits<real_t>::max(), std::numeric_limits<real_t>::max(), std::numeric_limits<real_t>::max());
+  vector3_t hi = -lo;
+  
+  for (std::size_t shell = 0; shell < 2; ++shell)
+  {
+    for (std::size_t i = 0; i < directions.size(); ++i)
+    {
+      vector3_t local = box.axes * (directions[i] * shell_radii[shell]);
+      
+      for (std::size_t axis = 0; axis < 3; ++axis)
+      {
+        lo[axis] = std::min(lo[axis], local[axis]);
+        hi[axis] = std::max(hi[axis], local[axis]);
+      }
+    }
+  }
+  
+  ///Widest gap between neighbouring sample directions
+  real_t unit_chord = 0;
+  
+  for (std::size_t v = 0; v < SAMPLES; ++v)
+  {
+    for (std::size_t u = 0; u < SAMPLES; ++u)
+    {
+      const vector3_t& direction = directions[v * SAMPLES + u];
+      
+      if (u > 0)
+        unit_chord = std::max(unit_chord, direction.distance(directions[v * SAMPLES + u - 1]));
+      if (v > 0)
+        unit_chord = std::max(unit_chord, direction.distance(directions[(v - 1) * SAMPLES + u]));
+    }
+  }
+  
+  ///The same gap on the outer shell
+  real_t chord = unit_chord * outer_radius;
+  
+  ///Plus a few ulps at planet scale, which deep patches are no bigger than
+  real_t pad = chord * chord / (real_t(8) * outer_radius)
+             + outer_radius * std::numeric_limits<real_t>::epsilon() * real_t(4);
+  vector3_t padding(pad, pad, pad);
+  
+  box.center = box.axes.transpose() * ((lo + hi) * real_t(.5));
+  box.half_extents = (hi - lo) * real_t(.5) + padding;
+  
+  bounds.center = box.center;
+  
+  real_t squared_radius = 0;
+  
+  for (std::size_t shell = 0; shell < 2; ++shell)
+    for (std::size_t i = 0; i < directions.size(); ++i)
+      squared_radius = std::max(squared_radius, (directions[i] * shell_radii[shell] - bounds.center).squared_length());
+  
+  bounds.radius = std::sqrt(squared_radius) + pad;
+  
+  bounds.direction = normal;
+  
+  ///Angles from chords rather than cosines, which lose small angles to rounding
+  real_t normal_chord = 0;
+  
+  for (std::size_t i = 0; i < directions.size(); ++i)
+    normal_chord = std::max(normal_chord, directions[i].distance(normal));
+  
+  ///Points between samples are within half the angle between neighbouring samples of one
+  bounds.angular_radius = real_t(2) * std::asin(std::min(real_t(1), normal_chord / real_t(2)))
+                        + std::asin(std::min(real_t(1), unit_chord / real_t(2)))
+                        + std::numeric_limits<real_t>::epsilon() * real_t(4);
+  
+  return bounds;
+}
+
+normal_cone_t compute_normal_cone(const std::vector<vector3_t>& positions, std::size_t width, std::size_t height,
+                                  const tile_transform_t& transform)
+{
+  BOOST_ASSERT(positions.size() == width * height);
+  BOOST_ASSERT(width > 1 && height > 1);
+  
+  std::vector<vector3_t> normals;
+  normals.reserve((width - 1) * (height - 1) * 2);
+  
+  vector3_t normal_sum;
+  
+  for (std::size_t y0 = 0; y0 < height - 1; ++y0)
+  {
+    for (std::size_t x0 = 0; x0 < width - 1; ++x0)
+    {
+      const vector3_t& x0y0 = positions[y0 * width + x0];
+      const vector3_t& x1y0 = positions[y0 * width + x0 + 1];
+      const vector3_t& x0y1 = positions[(y0 + 1) * width + x0];
+      const vector3_t& x1y1 = positions[(y0 + 1) * width + x0 + 1];
+      
+      ///(x0y0, x1y0, x1y1) and (x1y1, x0y1, x0y0), as in the index buffer
+      normals.push_back((x1y0 - x0y0).cross(x1y1 - x0y0).normalised());
+      normals.push_back((x0y1 - x1y1).cross(x0y0 - x1y1).normalised());
+      
+      normal_sum += normals[normals.size() - 2];
+      normal_sum += normals[normals.size() - 1];
+    }
+  }
+  
+  normal_cone_t cone;
+  
+  vector3_t local_axis = normal_sum.normalised();
+  
+  ///From chords, as acos of a dot product rounds the small angles of flat tiles away
+  real_t chord = 0;
+  
+  for (std::size_t i = 0; i < normals.size(); ++i)
+    chord = std::max(chord, normals[i].distance(local_axis));
+  
+  ///Tile-local to planet relative is a rotation and a (uniform, positive) scale, which normals only see the rotation of
+  cone.axis = transform.orientation * local_axis;
+  cone.angle = real_t(2) * std::asin(std::min(real_t(1), chord / real_t(2)))
+             + std::numeric_limits<real_t>::epsilon() * real_t(4);
+  
+  return cone;
+}
+
+} // namespace planet_core
@@ -0,0 +1,164 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_PLANET_GEOMETRY_H
+#define PLANET_CORE_PLANET_GEOMETRY_H
+
+#include "types.h"
+#include "quad_key.h"
+
+#include <cube/cube.h>
+
+#include <vector>
+
+namespace planet_core
+{
+
+///The [-1,1] face coordinate of @c corner of the node @c key
+vector2_t to_face_coordinates(const quad_key_t& key, const square::corner_t& corner);
+
+///Project a [-1,1] face coordinate of @c face onto the sphere of @c radius
+vector3_t to_planet_relative(const cube::face_t& face, const vector2_t& uv, real_t radius);
+
+///Project @c corner of the node @c key onto the sphere of @c radius
+vector3_t to_planet_relative(const quad_key_t& key, const square::corner_t& corner, real_t radius);
+
+///The rotation that takes the +z face onto @c face
+const matrix3_t& face_orientation(const cube::face_t& face);
+
+/**
+ * The node of the same level as @c key across its edge in @c direction,
+ * continuing onto the adjacent cube face past the edges of its own.
+ */
+quad_key_t adjacent_key(const quad_key_t& key, const square::direction_t& direction);
+
+
+///A box of any orientation
+struct oriented_box_t
+{
+  oriented_box_t()
+    : center()
+    , axes()
+    , half_extents()
+  {}
+  
+  vector3_t center;
+  ///Rows are the box's (orthonormal) axes; @c axes * (p - @c center) is @c p in box coordinates
+  matrix3_t axes;
+  ///Half size along each of @c axes
+  vector3_t half_extents;
+};
+
+///Bounding volumes of a node's patch, displaced anywhere within a height range
+struct node_bounds_t
+{
+  node_bounds_t()
+    : center()
+    , radius(0)
+    , box()
+    , direction()
+    , angular_radius(0)
+    , height_min(0)
+    , height_max(0)
+  {}
+  
+  ///Bounding sphere
+  vector3_t center;
+  real_t radius;
+  
+  ///Tighter bounds for culling; aligned to the patch's normal
+  oriented_box_t box;
+  
+  ///Unit direction from the planet's center through the patch's center
+  vector3_t direction;
+  ///Angle around @c direction, from the planet's center, that the patch spans
+  real_t angular_radius;
+  
+  ///The displacement range the volumes cover, relative to the planet's radius
+  real_t height_min;
+  real_t height_max;
+};
+
+/**
+ * Bound the patch of @c key on the sphere of @c radius, displaced outward by
+ * anything from @c height_min to @c height_max.
+ */
+node_bounds_t compute_node_bounds(const quad_key_t& key, real_t radius, real_t height_min, real_t height_max);
+
+
+///Placement of a tile's mesh relative to the planet: scale, then rotate, then translate
+struct tile_transform_t
+{
+  tile_transform_t()
+    : translation()
+    , scale(1)
+    , orientation()
+  {}
+  
+  ///Planet relative position to tile-local position
+  vector3_t to_local(const vector3_t& planet_relative) const
+  {
+    return (orientation.transpose() * (planet_relative - translation)) / scale;
+  }
+  
+  ///Tile-local position to planet relative position
+  vector3_t to_planet(const vector3_t& local) const
+  {
+    return translation + orientation * (local * scale);
+  }
+  
+  vector3_t translation;
+  real_t scale;
+  matrix3_t orientation;
+};
+
+
+///Bounds the facing (outward, counter-clockwise) normals of a mesh's triangles
+struct normal_cone_t
+{
+  ///A cone containing every direction: bounds any mesh
+  normal_cone_t()
+    : axis(0, 0, 1)
+    , angle(real_t(3.14159265358979323846))
+  {}
+  
+  ///Unit axis
+  vector3_t axis;
+  ///Half angle around @c axis
+  real_t angle;
+};
+
+/**
+ * Bound the normals of the triangles of a grid of @c width * @c height
+ * @c positions, two per cell with the winding of the tiles' index buffer,
+ * placed on the planet by @c transform.
+ */
+normal_cone_t compute_normal_cone(const std::vector<vector3_t>& positions, std::size_t width, std::size_t height,
+                                  const tile_transform_t& transform);
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_PLANET_GEOMETRY_H
@@ -0,0 +1,238 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_QUAD_KEY_H
+#define PLANET_CORE_QUAD_KEY_H
+
+#include <square/square.h>
+#include <cube/cube.h>
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
+
+namespace planet_core
+{
+
+/**
+ * Names a quad-node: its cube face, its level and its cell on that face.
+ * 
+ * The cell is a Morton code: the x and y cell coordinates with their bits
+ * interleaved (x in the even bits, y in the odd bits), which makes it the
+ * path of child corners from the face root, two bits per level. Parent,
+ * child and neighbor keys, and the node's face coordinates, are all plain
+ * integer arithmetic on it.
+ */
+struct quad_key_t
+{
+  typedef boost::uint64_t morton_t;
+  
+  ///Deepest level a key can name; each level takes two bits of the Morton code
+  static const std::size_t MAX_LEVEL = 31;
+  
+  ///The root of face 0
+  quad_key_t()
+    : mmorton(0)
+    , mface(0)
+    , mlevel(0)
+  {}
+  
+  quad_key_t(const cube::face_t& face, std::size_t level, morton_t morton)
+    : mmorton(morton)
+    , mface(face.index())
+    , mlevel(level)
+  {
+    BOOST_ASSERT(level <= MAX_LEVEL);
+    BOOST_ASSERT(level == MAX_LEVEL || (morton >> (2 * level)) == 0);
+  }
+  
+  ///The key of the node covering all of @c face
+  static quad_key_t root(const cube::face_t& face)
+  {
+    return quad_key_t(face, 0, 0);
+  }
+  
+  const cube::face_t& face() const
+  {return cube::face_t::get(mface);}
+  
+  std::size_t face_index() const
+  {return mface;}
+  
+  std::size_t level() const
+  {return mlevel;}
+  
+  morton_t morton() const
+  {return mmorton;}
+  
+  ///Cell column on the face, in [0, 2^level)
+  boost::uint32_t x() const
+  {return compact(mmorton);}
+  
+  ///Cell row on the face, in [0, 2^level)
+  boost::uint32_t y() const
+  {return compact(mmorton >> 1);}
+  
+  bool is_root() const
+  {return mlevel == 0;}
+  
+  quad_key_t parent() const
+  {
+    BOOST_ASSERT(!is_root());
+    return quad_key_t(mface, mlevel - 1, mmorton >> 2);
+  }
+  
+  quad_key_t child(const square::corner_t& corner) const
+  {
+    BOOST_ASSERT(mlevel < MAX_LEVEL);
+    return quad_key_t(mface, mlevel + 1, (mmorton << 2) | corner.index());
+  }
+  
+  ///Which child of its parent this is
+  const square::corner_t& corner() const
+  {
+    BOOST_ASSERT(!is_root());
+    return square::corner_t::get(mmorton & 3);
+  }
+  
+  ///Whether @c other is this node or lies below it
+  bool contains(const quad_key_t& other) const
+  {
+    return mface == other.mface && mlevel <= other.mlevel
+        && (other.mmorton >> (2 * (other.mlevel - mlevel))) == mmorton;
+  }
+  
+  /**
+   * The node of the same level across the edge in @c direction.
+   * 
+   * @return false, leaving @c result alone, when that edge is the face's own
+   *  edge; the neighbor is then on another face
+   */
+  bool neighbor(const square::direction_t& direction, quad_key_t& result) const
+  {
+    const boost::int64_t side = boost::int64_t(1) << mlevel;
+    const boost::int64_t nx = boost::int64_t(x()) + direction.x();
+    const boost::int64_t ny = boost::int64_t(y()) + direction.y();
+    
+    if (nx < 0 || ny < 0 || nx >= side || ny >= side)
+      return false;
+    
+    result = quad_key_t(mface, mlevel, spread(boost::uint32_t(nx)) | (spread(boost::uint32_t(ny)) << 1));
+    return true;
+  }
+  
+  /**
+   * Grid line @c i of this level in [0,1] face coordinates; the node spans
+   * lines x() to x() + 1 and y() to y() + 1.
+   * 
+   * Exact in double for every level; in float while 2^level fits the mantissa.
+   */
+  template<typename real_type>
+  real_type to_unit(boost::uint64_t i) const
+  {
+    return real_type(std::ldexp(double(i), -int(mlevel)));
+  }
+  
+  ///[0,1] face coordinate of @c corner of this node
+  template<typename real_type>
+  real_type corner_u(const square::corner_t& corner) const
+  {return to_unit<real_type>(boost::uint64_t(x()) + corner.x_i());}
+  
+  template<typename real_type>
+  real_type corner_v(const square::corner_t& corner) const
+  {return to_unit<real_type>(boost::uint64_t(y()) + corner.y_i());}
+  
+  ///Readable and unique, e.g. for naming per-node resources
+  std::string name() const;
+  
+  bool operator==(const quad_key_t& other) const
+  {return mmorton == other.mmorton && mface == other.mface && mlevel == other.mlevel;}
+  
+  bool operator!=(const quad_key_t& other) const
+  {return !(*this == other);}
+  
+  ///Face, then level, then Morton order
+  bool operator<(const quad_key_t& other) const
+  {
+    if (mface != other.mface)
+      return mface < other.mface;
+    if (mlevel != other.mlevel)
+      return mlevel < other.mlevel;
+    return mmorton < other.mmorton;
+  }
+  
+  ///Interleave the bits of @c v with zeros, into the even bits
+  static morton_t spread(boost::uint32_t v)
+  {
+    morton_t r = v;
+    r = (r | (r << 16)) & 0x0000FFFF0000FFFFULL;
+    r = (r | (r << 8))  & 0x00FF00FF00FF00FFULL;
+    r = (r | (r << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    r = (r | (r << 2))  & 0x3333333333333333ULL;
+    r = (r | (r << 1))  & 0x5555555555555555ULL;
+    return r;
+  }
+  
+  ///Inverse of @c spread(), reading the even bits of @c m
+  static boost::uint32_t compact(morton_t m)
+  {
+    m &= 0x5555555555555555ULL;
+    m = (m | (m >> 1))  & 0x3333333333333333ULL;
+    m = (m | (m >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    m = (m | (m >> 4))  & 0x00FF00FF00FF00FFULL;
+    m = (m | (m >> 8))  & 0x0000FFFF0000FFFFULL;
+    m = (m | (m >> 16)) & 0x00000000FFFFFFFFULL;
+    return boost::uint32_t(m);
+  }
+  
+private:
+  quad_key_t(std::size_t face, std::size_t level, morton_t morton)
+    : mmorton(morton)
+    , mface(face)
+    , mlevel(level)
+  {}
+  
+  morton_t mmorton;
+  boost::uint8_t mface;
+  boost::uint8_t mlevel;
+};
+
+///For @c boost::hash and the unordered containers
+inline std::size_t hash_value(const quad_key_t& key)
+{
+  boost::uint64_t h = key.morton() ^ ((boost::uint64_t(key.level()) << 3 | key.face_index()) * 0x9e3779b97f4a7c15ULL);
+  
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  
+  return std::size_t(h);
+}
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_QUAD_KEY_H
@@ -0,0 +1,151 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "residency.h"
+
+#include <algorithm>
+#include <boost/assert.hpp>
+
+namespace planet_core
+{
+
+residency_manager_t::entry_t::entry_t(node_handle_t node, std::size_t bytes, std::size_t frame)
+  : node(node)
+  , bytes(bytes)
+  , frame(frame)
+{
+
+}
+
+
+residency_manager_t::residency_manager_t(std::size_t budget)
+  : mbudget(budget)
+  , musage(0)
+  , mpeak_usage(0)
+  , frame(0)
+{
+
+}
+
+void residency_manager_t::begin_frame()
+{
+  ++frame;
+}
+
+void residency_manager_t::insert(node_handle_t node, std::size_t bytes)
+{
+  BOOST_ASSERT(!contains(node));
+  
+  entries.push_back(entry_t(node, bytes, frame));
+  
+  musage += bytes;
+  mpeak_usage = std::max(mpeak_usage, musage);
+}
+
+void residency_manager_t::erase(node_handle_t node)
+{
+  typedef entries_t::nth_index<1>::type by_node_t;
+  by_node_t& by_node = entries.get<1>();
+  
+  by_node_t::iterator w = by_node.find(node);
+  
+  if (w == by_node.end())
+    return;
+  
+  BOOST_ASSERT(musage >= w->bytes);
+  musage -= w->bytes;
+  
+  by_node.erase(w);
+}
+
+bool residency_manager_t::contains(node_handle_t node) const
+{
+  return entries.get<1>().count(node) != 0;
+}
+
+void residency_manager_t::touch(node_handle_t node)
+{
+  typedef entries_t::nth_index<1>::type by_node_t;
+  by_node_t& by_node = entries.get<1>();
+  
+  by_node_t::iterator w = by_node.find(node);
+  
+  BOOST_ASSERT(w != by_node.end());
+  
+  if (w->frame == frame)
+    return;
+  
+  entry_t entry = *w;
+  entry.frame = frame;
+  by_node.replace(w, entry);
+  
+  ///Move it to the most recently used end
+  entries.get<0>().relocate(entries.get<0>().end(), entries.project<0>(w));
+}
+
+void residency_manager_t::evict(std::vector<node_handle_t>& evicted)
+{
+  typedef entries_t::nth_index<0>::type lru_t;
+  lru_t& lru = entries.get<0>();
+  
+  while (musage > mbudget && !lru.empty() && lru.front().frame != frame)
+  {
+    const entry_t& entry = lru.front();
+    
+    BOOST_ASSERT(musage >= entry.bytes);
+    musage -= entry.bytes;
+    evicted.push_back(entry.node);
+    
+    lru.pop_front();
+  }
+}
+
+std::size_t residency_manager_t::usage() const
+{
+  return musage;
+}
+
+std::size_t residency_manager_t::peak_usage() const
+{
+  return mpeak_usage;
+}
+
+std::size_t residency_manager_t::resident_count() const
+{
+  return entries.size();
+}
+
+std::size_t residency_manager_t::budget() const
+{
+  return mbudget;
+}
+
+void residency_manager_t::set_budget(std::size_t budget)
+{
+  mbudget = budget;
+}
+
+} // namespace planet_core
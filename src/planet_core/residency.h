@@ -0,0 +1,109 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_RESIDENCY_H
+#define PLANET_CORE_RESIDENCY_H
+
+#include "node_store.h"
+
+#include <vector>
+
+#include <boost/multi_index/indexed_by.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index_container.hpp>
+
+#include <boost/noncopyable.hpp>
+
+namespace planet_core
+{
+
+/**
+ * Accounts the front end resources (textures, vertex buffers...) of nodes
+ * against a byte budget, and picks the least recently used ones to evict.
+ * 
+ * Only does the bookkeeping; the front end owns the resources and releases
+ * them, and must @c erase() a node before it is destroyed.
+ */
+struct residency_manager_t
+  : boost::noncopyable
+{
+  explicit residency_manager_t(std::size_t budget);
+  
+  ///Start a new frame; nodes touched during it will not be evicted
+  void begin_frame();
+  
+  ///@c node now holds @c bytes of resources; it counts as used this frame
+  void insert(node_handle_t node, std::size_t bytes);
+  void erase(node_handle_t node);
+  bool contains(node_handle_t node) const;
+  
+  ///@c node is used this frame
+  void touch(node_handle_t node);
+  
+  ///Remove nodes from the residency, least recently used first, until @c usage() is
+  /// within @c budget(), and append them to @c evicted for the front end to release.
+  ///Nodes used this frame are never picked
+  void evict(std::vector<node_handle_t>& evicted);
+  
+  std::size_t usage() const;
+  std::size_t peak_usage() const;
+  std::size_t resident_count() const;
+  
+  std::size_t budget() const;
+  void set_budget(std::size_t budget);
+  
+private:
+  struct entry_t
+  {
+    entry_t(node_handle_t node, std::size_t bytes, std::size_t frame);
+    
+    node_handle_t node;
+    std::size_t bytes;
+    ///Frame of the last use
+    std::size_t frame;
+  };
+  
+  typedef boost::multi_index_container<
+    entry_t,
+    boost::multi_index::indexed_by<
+      boost::multi_index::sequenced<>, // least recently used first
+      boost::multi_index::ordered_unique< boost::multi_index::member<entry_t, node_handle_t, &entry_t::node> >
+    >
+  > entries_t;
+  
+  entries_t entries;
+  
+  std::size_t mbudget;
+  std::size_t musage;
+  std::size_t mpeak_usage;
+  std::size_t frame;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_RESIDENCY_H
@@ -0,0 +1,393 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "tile.h"
+
+#include <cmath>
+#include <algorithm>
+#include <boost/assert.hpp>
+#include <boost/foreach.hpp>
+
+namespace planet_core
+{
+
+tile_layout_t::tile_layout_t(std::size_t noise_res, std::size_t vertices_width, std::size_t vertices_height)
+  : noise_res(noise_res)
+  , bordered_noise_res(1 + noise_res + 1)
+  , noise_width(bordered_noise_res)
+  , noise_height(bordered_noise_res)
+  , vertices_width(vertices_width)
+  , vertices_height(vertices_height)
+  , heightmap_width(1 + vertices_width + 1)
+  , heightmap_height(1 + vertices_height + 1)
+  , vertex_count(vertices_width * vertices_height)
+  , static_index_count((vertices_width-1)*(vertices_height-1)*6)
+{
+
+}
+
+
+namespace
+{
+  ///Vertex @c t along an edge of a tile of @c cells a side, @c depth rows in from it;
+  ///each edge is the bottom (-y) one turned around the tile, which keeps the winding
+  boost::uint32_t edge_vertex(const square::direction_t& direction, std::size_t cells, std::size_t t, std::size_t depth)
+  {
+    std::size_t x, y;
+    
+    if (direction.y() < 0)
+    {
+      x = t;
+      y = depth;
+    } else if (direction.x() > 0) {
+      x = cells - depth;
+      y = t;
+    } else if (direction.y() > 0) {
+      x = cells - t;
+      y = cells - depth;
+    } else {
+      x = depth;
+      y = cells - t;
+    }
+    
+    return boost::uint32_t(y * (cells + 1) + x);
+  }
+} // anonymous namespace
+
+void generate_tile_indices(const tile_layout_t& layout, boost::uint8_t coarser_edges, std::vector<boost::uint32_t>& indices)
+{
+  const std::size_t vertices_width = layout.vertices_width;
+  const std::size_t vertices_height = layout.vertices_height;
+  
+  indices.clear();
+  
+  if (!coarser_edges)
+  {
+    for (std::size_t y0 = 0; y0 < (vertices_height- 1); ++y0)
+    {
+      for (std::size_t x0 = 0; x0 < (vertices_width - 1); ++x0)
+      {
+        std::size_t x1 = x0 + 1;
+        std::size_t y1 = y0 + 1;
+        
+        boost::uint32_t x0y0i = boost::uint32_t((y0 * vertices_width) + x0);
+        boost::uint32_t x0y1i = boost::uint32_t((y1 * vertices_width) + x0);
+        boost::uint32_t x1y0i = boost::uint32_t((y0 * vertices_width) + x1);
+        boost::uint32_t x1y1i = boost::uint32_t((y1 * vertices_width) + x1);
+        
+        indices.push_back(x0y0i);
+        indices.push_back(x1y0i);
+        indices.push_back(x1y1i);
+        
+        indices.push_back(x1y1i);
+        indices.push_back(x0y1i);
+        indices.push_back(x0y0i);
+      }
+    }
+    
+    BOOST_ASSERT(indices.size() == layout.static_index_count);
+    return;
+  }
+  
+  BOOST_ASSERT(vertices_width == vertices_height);
+  
+  const std::size_t cells = vertices_width - 1;
+  
+  BOOST_ASSERT(cells >= 2 && cells % 2 == 0);
+  
+  ///Cells clear of every edge, as in the unstitched grid
+  for (std::size_t y0 = 1; y0 + 1 < cells; ++y0)
+  {
+    for (std::size_t x0 = 1; x0 + 1 < cells; ++x0)
+    {
+      boost::uint32_t x0y0i = boost::uint32_t((y0 * vertices_width) + x0);
+      boost::uint32_t x0y1i = boost::uint32_t(((y0 + 1) * vertices_width) + x0);
+      boost::uint32_t x1y0i = boost::uint32_t((y0 * vertices_width) + x0 + 1);
+      boost::uint32_t x1y1i = boost::uint32_t(((y0 + 1) * vertices_width) + x0 + 1);
+      
+      indices.push_back(x0y0i);
+      indices.push_back(x1y0i);
+      indices.push_back(x1y1i);
+      
+      indices.push_back(x1y1i);
+      indices.push_back(x0y1i);
+      indices.push_back(x0y0i);
+    }
+  }
+  
+  /**
+   * Each edge's strip, zipped between the edge's vertices (every other one
+   * if stitched) from corner to corner, and the inner ring's from one inner
+   * corner to the next; the strips meet on the corner cells' diagonals.
+   */
+  BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+  {
+    const std::size_t step = (coarser_edges & (1 << direction.index())) ? 2 : 1;
+    
+    std::size_t outer = 0;
+    std::size_t inner = 1;
+    
+    while (outer < cells || inner + 1 < cells)
+    {
+      bool advance_outer = inner + 1 == cells || (outer < cells && outer + step <= inner + 1);
+      
+      indices.push_back(edge_vertex(direction, cells, outer, 0));
+      
+      if (advance_outer)
+      {
+        indices.push_back(edge_vertex(direction, cells, outer + step, 0));
+        indices.push_back(edge_vertex(direction, cells, inner, 1));
+        outer += step;
+      } else {
+        indices.push_back(edge_vertex(direction, cells, inner + 1, 1));
+        indices.push_back(edge_vertex(direction, cells, inner, 1));
+        inner += 1;
+      }
+    }
+  }
+}
+
+void generate_morph_targets(const tile_layout_t& layout, const std::vector<vector3_t>& positions,
+                            std::vector<vector3_t>& targets)
+{
+  const std::size_t vertices_width = layout.vertices_width;
+  const std::size_t vertices_height = layout.vertices_height;
+  
+  BOOST_ASSERT(positions.size() == layout.vertex_count);
+  BOOST_ASSERT((vertices_width - 1) % 2 == 0 && (vertices_height - 1) % 2 == 0);
+  
+  targets.resize(positions.size());
+  
+  for (std::size_t vv = 0; vv < vertices_height; ++vv)
+  {
+    for (std::size_t vu = 0; vu < vertices_width; ++vu)
+    {
+      std::size_t i = vv * vertices_width + vu;
+      
+      bool edge = vu == 0 || vv == 0 || vu + 1 == vertices_width || vv + 1 == vertices_height;
+      bool odd_u = vu % 2 != 0;
+      bool odd_v = vv % 2 != 0;
+      
+      if (edge || (!odd_u && !odd_v))
+      {
+        targets[i] = positions[i];
+        continue;
+      }
+      
+      ///The parent's grid line, or its cell's (x0y0, x1y1) diagonal, as its index buffer cuts it
+      std::size_t du = odd_u ? 1 : 0;
+      std::size_t dv = odd_v ? vertices_width : 0;
+      
+      targets[i] = (positions[i - du - dv] + positions[i + du + dv]) * real_t(.5);
+    }
+  }
+}
+
+
+tile_generator_t::tile_generator_t(const tile_layout_t& layout, real_t radius, noise_hierarchy_t& noise_hierarchy, noise_slab_t& noise_slab)
+  : layout(layout)
+  , radius(radius)
+  , noise_slab(noise_slab)
+  , noise_context(noise_hierarchy)
+{
+  BOOST_ASSERT(noise_slab.tile_size == layout.noise_width * layout.noise_height);
+
+}
+
+void tile_generator_t::set_sample(std::size_t i, const vector3_t& position)
+{
+  batch.x[i] = position.x;
+  batch.y[i] = position.y;
+  batch.z[i] = position.z;
+}
+
+void tile_generator_t::generate_root_noise(const quad_key_t& key, tile_t& tile)
+{
+  const std::size_t noise_width = layout.noise_width;
+  const std::size_t noise_height = layout.noise_height;
+  
+  const cube::face_t face = key.face();
+  
+  vector2_t omin = to_face_coordinates(key, square::corner_t::get(false, false));
+  vector2_t omax = to_face_coordinates(key, square::corner_t::get(true, true));
+  
+  batch.resize(noise_width * noise_height);
+  
+  for (std::size_t v = 0; v < noise_height; ++v)
+  {
+    for (std::size_t u = 0; u < noise_width; ++u)
+    {
+      vector2_t relative_sphere_face_position2d = omin + (omax - omin) * (vector2_t(u,v)/vector2_t(noise_width - 1, noise_height - 1));
+      
+      set_sample(v * noise_width + u, to_planet_relative(face, relative_sphere_face_position2d, radius));
+    }
+  }
+  
+  noise_context.evaluate(0, batch);
+  
+  tile.noise = noise_slab.allocate();
+  std::copy(batch.values.begin(), batch.values.end(), tile.noise->values());
+  
+  real_t error = 0;
+  
+  for (std::size_t i = 0; i < batch.values.size(); ++i)
+    error = std::max(error, real_t(std::abs(batch.values[i])));
+  
+  tile.error = error;
+}
+
+void tile_generator_t::generate_child_noise(const quad_key_t& key, const float* parent_noise, tile_t& tile)
+{
+  const std::size_t noise_res = layout.noise_res;
+  const std::size_t noise_width = layout.noise_width;
+  const std::size_t noise_height = layout.noise_height;
+  
+  BOOST_ASSERT(parent_noise);
+  
+  const cube::face_t face = key.face();
+  
+  vector2_t omin = to_face_coordinates(key, square::corner_t::get(false, false));
+  vector2_t omax = to_face_coordinates(key, square::corner_t::get(true, true));
+  
+  const std::size_t level = key.level();
+  const square::corner_t& corner = key.corner();
+  
+  ///Each parent texel of the quadrant covers 2x2 child texels
+  std::size_t pv0 = corner.y() ? noise_height / 2 : 0;
+  std::size_t pu0 = corner.x() ? noise_width / 2 : 0;
+  
+  std::size_t v_end = (noise_height / 2) * 2;
+  std::size_t u_end = (noise_width / 2) * 2;
+  
+  BOOST_ASSERT(v_end <= noise_height && u_end <= noise_width);
+  
+  batch.resize(noise_width * noise_height);
+  
+  for (std::size_t v = 0; v < v_end; ++v)
+  {
+    for (std::size_t u = 0; u < u_end; ++u)
+    {
+      vector2_t relative_sphere_face_position2d = omin + (omax - omin)
+        * (vector2_t(real_t(u)-real_t(1),real_t(v)-real_t(1))/vector2_t(noise_res - 1, noise_res - 1));
+      
+      set_sample(v * noise_width + u, to_planet_relative(face, relative_sphere_face_position2d, radius));
+    }
+  }
+  
+  noise_context.evaluate(level, batch);
+  
+  tile.noise = noise_slab.allocate();
+  
+  float* noise_buf_ptr0 = tile.noise->values();
+  const float* p_noise_buf_ptr0 = parent_noise;
+  const float* values_ptr0 = &batch.values[0];
+  
+  real_t factor = (radius / 500) / std::pow(real_t(2), real_t(level));
+  
+  ///How far this level moves the surface away from its parent's
+  real_t residual = 0;
+  
+  for (std::size_t v = 0; v < v_end; ++v)
+  {
+    std::size_t pv = pv0 + v / 2;
+    
+    for (std::size_t u = 0; u < u_end; ++u)
+    {
+      std::size_t pu = pu0 + u / 2;
+      
+      std::size_t uvi = v * noise_width + u;
+      std::size_t puvi = pv * noise_width + pu;
+      
+      BOOST_ASSERT(puvi < (noise_width * noise_height));
+      
+      real_t delta = values_ptr0[uvi] * factor;
+      
+      noise_buf_ptr0[ uvi ] = p_noise_buf_ptr0[puvi] + delta;
+      residual = std::max(residual, std::abs(delta));
+    }
+  }
+  
+  tile.error = residual;
+}
+
+void tile_generator_t::generate_mesh(const quad_key_t& key, tile_t& tile) const
+{
+  const std::size_t vertices_width = layout.vertices_width;
+  const std::size_t vertices_height = layout.vertices_height;
+  
+  const cube::face_t face = key.face();
+  
+  vector2_t omin = to_face_coordinates(key, square::corner_t::get(false, false));
+  vector2_t omax = to_face_coordinates(key, square::corner_t::get(true, true));
+  
+  tile_transform_t& transform = tile.transform;
+  transform.orientation = face_orientation(face);
+  transform.scale = radius / std::pow(real_t(2), real_t(key.level()));
+  transform.translation = to_planet_relative(face, omin, radius);
+  
+  tile.positions.resize(layout.vertex_count);
+  
+  for (std::size_t vv = 0; vv < vertices_height; ++vv)
+  {
+    for (std::size_t vu = 0; vu < vertices_width; ++vu)
+    {
+      std::size_t vertex_buf_index = vv * vertices_width + vu;
+      
+      BOOST_ASSERT(vertex_buf_index < layout.vertex_count);
+      
+      vector2_t relative_sphere_face_position2d = omin + (omax - omin) * (vector2_t(vu,vv)/vector2_t(vertices_width - 1, vertices_height - 1));
+      vector3_t surface_postion = to_planet_relative(face, relative_sphere_face_position2d, radius);
+      
+      tile.positions[vertex_buf_index] = transform.to_local(surface_postion);
+    }
+  }
+  
+  tile.normal_cone = compute_normal_cone(tile.positions, vertices_width, vertices_height, transform);
+  
+  ///The sphere bulges above a cell's diagonal by its sagitta, which smooth terrain still has to resolve
+  real_t cell_diagonal = (tile.positions.back() - tile.positions.front()).length() * transform.scale
+                       / real_t(std::max(vertices_width, vertices_height) - 1);
+  real_t half_diagonal = std::min(radius, cell_diagonal / 2);
+  
+  tile.error = std::max(tile.error, radius - std::sqrt(radius * radius - half_diagonal * half_diagonal));
+  
+  generate_bounds(key, tile);
+}
+
+void tile_generator_t::generate_bounds(const quad_key_t& key, tile_t& tile) const
+{
+  BOOST_ASSERT(!!tile.noise);
+  
+  const float* noise = tile.noise->values();
+  const float* noise_end = noise + layout.noise_width * layout.noise_height;
+  
+  real_t height_min = std::min(real_t(0), real_t(*std::min_element(noise, noise_end)));
+  real_t height_max = std::max(real_t(0), real_t(*std::max_element(noise, noise_end)));
+  
+  tile.bounds = compute_node_bounds(key, radius, height_min, height_max);
+}
+
+} // namespace planet_core
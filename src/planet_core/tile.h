@@ -0,0 +1,167 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_TILE_H
+#define PLANET_CORE_TILE_H
+
+#include "types.h"
+#include "quad_key.h"
+#include "planet_geometry.h"
+#include "noise_batch.h"
+#include "noise_stack.h"
+#include "noise_slab.h"
+
+#include <cube/cube.h>
+#include <square/square.h>
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace planet_core
+{
+
+///Dimensions shared by every tile of a planet
+struct tile_layout_t
+{
+  tile_layout_t(std::size_t noise_res, std::size_t vertices_width, std::size_t vertices_height);
+  
+  const std::size_t noise_res;
+  
+  //bordered noise resolution
+  const std::size_t bordered_noise_res;
+  
+  const std::size_t noise_width;
+  const std::size_t noise_height;
+  
+  const std::size_t vertices_width;
+  const std::size_t vertices_height;
+  
+  const std::size_t heightmap_width;
+  const std::size_t heightmap_height;
+  
+  const std::size_t vertex_count;
+  const std::size_t static_index_count;
+};
+
+/**
+ * Triangulate a tile's vertex grid, counter-clockwise seen from outside, as
+ * triangle list @c indices.
+ * 
+ * Edges in @c coarser_edges (bit @c direction.index() for each
+ * @c square::direction_t) meet a neighbor one level coarser, which only has
+ * every other vertex of the edge: their strip of cells is triangulated
+ * without the odd ones, so no T-junction opens a crack. Needs square tiles
+ * with an even number of cells a side, for any stitched edge.
+ */
+void generate_tile_indices(const tile_layout_t& layout, boost::uint8_t coarser_edges, std::vector<boost::uint32_t>& indices);
+
+/**
+ * Where each of a tile's @c positions lies on its parent's mesh: the
+ * midpoint of the edge or cell diagonal of the parent's grid it splits, or
+ * itself where the parent has the same vertex. Edge vertices stay put, as
+ * they are shared with neighbors. Needs an even number of cells a side.
+ */
+void generate_morph_targets(const tile_layout_t& layout, const std::vector<vector3_t>& positions,
+                            std::vector<vector3_t>& targets);
+
+///CPU side data of a single quad-node
+struct tile_t
+{
+  tile_t()
+    : error(0)
+  {}
+  
+  ///Bordered noise samples, @c noise_width * @c noise_height, row major.
+  ///Shared with the jobs generating this tile's children
+  noise_tile_ptr_t noise;
+  
+  ///Tile-local vertex positions, @c vertices_width * @c vertices_height, row major
+  std::vector<vector3_t> positions;
+  
+  ///Places @c positions relative to the planet
+  tile_transform_t transform;
+  
+  ///Bounds of the node's patch over the range of @c noise
+  node_bounds_t bounds;
+  
+  ///Bounds the normals of the triangles of @c positions, planet relative
+  normal_cone_t normal_cone;
+  
+  /**
+   * Geometric error of the tile against its parent's, planet units: the
+   * largest noise residual it adds, or the sphere's bulge between its
+   * vertices if that is larger.
+   */
+  real_t error;
+};
+
+/**
+ * Fills @c tile_t's from the noise hierarchy; holds no Ogre state.
+ * 
+ * A generator is used by one thread at a time; use one per thread.
+ */
+struct tile_generator_t
+  : boost::noncopyable
+{
+  ///@param noise_slab must hold @c noise_width * @c noise_height tiles
+  tile_generator_t(const tile_layout_t& layout, real_t radius, noise_hierarchy_t& noise_hierarchy, noise_slab_t& noise_slab);
+  
+  ///Sample the noise for a root node directly; its error is its largest sample
+  void generate_root_noise(const quad_key_t& key, tile_t& tile);
+  
+  ///Sample the noise for a child, on top of its quadrant (@c key.corner()) of its parent's noise; records the residual as its error
+  void generate_child_noise(const quad_key_t& key, const float* parent_noise, tile_t& tile);
+  
+  ///Build the tile-local vertex positions, the tile's transform and its normal cone; also generates the bounds.
+  ///Raises the error to the sphere's bulge between vertices
+  void generate_mesh(const quad_key_t& key, tile_t& tile) const;
+  
+  /**
+   * Bound the tile's patch over its noise: displaced by anything from the
+   * noise's lowest to highest sample, and by nothing, as the undisplaced
+   * surface is what is drawn until the terrain is displaced.
+   */
+  void generate_bounds(const quad_key_t& key, tile_t& tile) const;
+  
+  const tile_layout_t& layout;
+  const real_t radius;
+private:
+  ///Queue @c position as sample @c i of @c batch
+  void set_sample(std::size_t i, const vector3_t& position);
+  
+  noise_slab_t& noise_slab;
+  
+  ///This generator's caches; lets generators on other threads sample the same levels without locking
+  noise_context_t noise_context;
+  
+  ///Scratch request, reused so a tile costs no allocations once warmed up
+  noise_batch_t batch;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_TILE_H
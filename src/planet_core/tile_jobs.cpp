@@ -0,0 +1,180 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "tile_jobs.h"
+
+#include <algorithm>
+#include <functional>
+#include <boost/assert.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+namespace planet_core
+{
+
+tile_job_t::tile_job_t(node_handle_t node, const quad_key_t& key,
+                       const noise_tile_ptr_t& parent_noise)
+  : node(node)
+  , key(key)
+  , parent_noise(parent_noise)
+{
+
+}
+
+
+tile_job_pool_t::tile_job_pool_t(const tile_layout_t& layout, real_t radius,
+                                 noise_hierarchy_t& noise_hierarchy, noise_slab_t& noise_slab,
+                                 std::size_t worker_count)
+  : running(0)
+  , stopping(false)
+{
+  for (std::size_t i = 0; i < worker_count + 1; ++i)
+    generators.push_back(new tile_generator_t(layout, radius, noise_hierarchy, noise_slab));
+  
+  for (std::size_t i = 0; i < worker_count; ++i)
+    workers.create_thread(boost::bind(&tile_job_pool_t::worker_main, this, boost::ref(generators[i + 1])));
+}
+
+tile_job_pool_t::~tile_job_pool_t()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+    queued.clear();
+  }
+  
+  work_available.notify_all();
+  workers.join_all();
+}
+
+std::size_t tile_job_pool_t::default_worker_count()
+{
+  std::size_t hardware_threads = boost::thread::hardware_concurrency();
+  
+  return std::max(std::size_t(1), hardware_threads > 1 ? hardware_threads - 1 : 0);
+}
+
+std::size_t tile_job_pool_t::worker_count() const
+{
+  return generators.size() - 1;
+}
+
+void tile_job_pool_t::submit(const job_ptr_t& job)
+{
+  BOOST_ASSERT(!!job);
+  BOOST_ASSERT(!job->tile);
+  
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    queued.push_back(job);
+  }
+  
+  work_available.notify_one();
+}
+
+void tile_job_pool_t::collect(std::vector<job_ptr_t>& result)
+{
+  if (worker_count() == 0)
+  {
+    while (!queued.empty())
+    {
+      job_ptr_t job = queued.front();
+      queued.pop_front();
+      
+      run(generators[0], *job);
+      finished.push_back(job);
+    }
+  }
+  
+  boost::mutex::scoped_lock lock(mutex);
+  
+  result.insert(result.end(), finished.begin(), finished.end());
+  finished.clear();
+}
+
+void tile_job_pool_t::cancel(const std::vector<node_handle_t>& nodes)
+{
+  BOOST_ASSERT(std::adjacent_find(nodes.begin(), nodes.end(), std::greater_equal<node_handle_t>()) == nodes.end());
+  
+  if (nodes.empty())
+    return;
+  
+  boost::mutex::scoped_lock lock(mutex);
+  
+  std::deque<job_ptr_t> kept;
+  
+  BOOST_FOREACH(const job_ptr_t& job, queued)
+  {
+    if (!std::binary_search(nodes.begin(), nodes.end(), job->node))
+      kept.push_back(job);
+  }
+  
+  queued.swap(kept);
+}
+
+std::size_t tile_job_pool_t::outstanding() const
+{
+  boost::mutex::scoped_lock lock(mutex);
+  
+  return queued.size() + running + finished.size();
+}
+
+void tile_job_pool_t::worker_main(tile_generator_t& generator)
+{
+  boost::mutex::scoped_lock lock(mutex);
+  
+  while (true)
+  {
+    while (!stopping && queued.empty())
+      work_available.wait(lock);
+    
+    if (stopping)
+      return;
+    
+    job_ptr_t job = queued.front();
+    queued.pop_front();
+    ++running;
+    
+    lock.unlock();
+    run(generator, *job);
+    lock.lock();
+    
+    --running;
+    finished.push_back(job);
+  }
+}
+
+void tile_job_pool_t::run(tile_generator_t& generator, tile_job_t& job)
+{
+  boost::scoped_ptr<tile_t> tile(new tile_t);
+  
+  generator.generate_child_noise(job.key, job.parent_noise->values(), *tile);
+  generator.generate_mesh(job.key, *tile);
+  
+  job.tile.swap(tile);
+}
+
+} // namespace planet_core
@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_TILE_JOBS_H
+#define PLANET_CORE_TILE_JOBS_H
+
+#include "types.h"
+#include "tile.h"
+#include "node_store.h"
+
+#include <cube/cube.h>
+#include <square/square.h>
+
+#include <deque>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace planet_core
+{
+
+struct noise_hierarchy_t;
+
+///A child tile to be generated off the render thread
+struct tile_job_t
+  : boost::noncopyable
+{
+  tile_job_t(node_handle_t node, const quad_key_t& key,
+             const noise_tile_ptr_t& parent_noise);
+  
+  ///The node the tile is for; stale if the node was joined away meanwhile
+  const node_handle_t node;
+  
+  //Inputs, held by the job so workers never look at the tree
+  const quad_key_t key;
+  ///The parent's tile, kept alive by the job; never written once generated
+  const noise_tile_ptr_t parent_noise;
+  
+  ///Output, set once the job is finished
+  boost::scoped_ptr<tile_t> tile;
+};
+
+/**
+ * Generates child tiles (noise and mesh) on a set of worker threads.
+ * 
+ * Jobs are run in submission order; finished jobs are handed back through
+ * @c collect(), on the caller's thread, which is where any GPU upload belongs.
+ * Workers never look at the node store, so jobs for nodes joined away are
+ * @c cancel()ed by the caller; ones already running still finish.
+ * With zero workers, @c collect() runs the queued jobs itself.
+ */
+struct tile_job_pool_t
+  : boost::noncopyable
+{
+  typedef boost::shared_ptr<tile_job_t> job_ptr_t;
+  
+  tile_job_pool_t(const tile_layout_t& layout, real_t radius,
+                  noise_hierarchy_t& noise_hierarchy, noise_slab_t& noise_slab,
+                  std::size_t worker_count);
+  ///Drops the jobs not yet started and waits for the running ones
+  ~tile_job_pool_t();
+  
+  void submit(const job_ptr_t& job);
+  
+  ///Append the finished jobs to @c finished
+  void collect(std::vector<job_ptr_t>& finished);
+  
+  ///Drop the jobs not yet started for @c nodes (sorted), which are no longer wanted
+  void cancel(const std::vector<node_handle_t>& nodes);
+  
+  ///Jobs submitted but not collected yet
+  std::size_t outstanding() const;
+  
+  std::size_t worker_count() const;
+  
+  ///One less than the hardware threads, so the render thread keeps a core; at least one
+  static std::size_t default_worker_count();
+private:
+  void worker_main(tile_generator_t& generator);
+  void run(tile_generator_t& generator, tile_job_t& job);
+  
+  mutable boost::mutex mutex;
+  boost::condition_variable work_available;
+  
+  std::deque<job_ptr_t> queued;
+  std::vector<job_ptr_t> finished;
+  std::size_t running;
+  bool stopping;
+  
+  ///One per worker, plus one for running jobs inline; each owns its scratch buffers
+  boost::ptr_vector<tile_generator_t> generators;
+  boost::thread_group workers;
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_TILE_JOBS_H
@@ -0,0 +1,205 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef PLANET_CORE_TYPES_H
+#define PLANET_CORE_TYPES_H
+
+#include <cmath>
+#include <cstddef>
+#include <boost/assert.hpp>
+
+namespace planet_core
+{
+#ifndef PLANET_CORE_FLOAT_TYPE
+#define PLANET_CORE_FLOAT_TYPE float
+#endif
+
+typedef PLANET_CORE_FLOAT_TYPE real_t;
+
+
+///Minimal 2D vector, so the tile pipeline does not need Ogre
+struct vector2_t
+{
+  vector2_t()
+    : x(0), y(0)
+  {}
+  
+  vector2_t(real_t x, real_t y)
+    : x(x), y(y)
+  {}
+  
+  real_t operator[](std::size_t i) const
+  {
+    BOOST_ASSERT(i < 2);
+    return i ? y : x;
+  }
+  
+  real_t& operator[](std::size_t i)
+  {
+    BOOST_ASSERT(i < 2);
+    return i ? y : x;
+  }
+  
+  vector2_t operator+(const vector2_t& other) const
+  {return vector2_t(x + other.x, y + other.y);}
+  
+  vector2_t operator-(const vector2_t& other) const
+  {return vector2_t(x - other.x, y - other.y);}
+  
+  ///Component-wise product
+  vector2_t operator*(const vector2_t& other) const
+  {return vector2_t(x * other.x, y * other.y);}
+  
+  ///Component-wise quotient
+  vector2_t operator/(const vector2_t& other) const
+  {return vector2_t(x / other.x, y / other.y);}
+  
+  vector2_t operator*(real_t s) const
+  {return vector2_t(x * s, y * s);}
+  
+  real_t x;
+  real_t y;
+};
+
+///Minimal 3D vector, so the tile pipeline does not need Ogre
+struct vector3_t
+{
+  vector3_t()
+    : x(0), y(0), z(0)
+  {}
+  
+  vector3_t(real_t x, real_t y, real_t z)
+    : x(x), y(y), z(z)
+  {}
+  
+  real_t operator[](std::size_t i) const
+  {
+    BOOST_ASSERT(i < 3);
+    return (i == 0) ? x : (i == 1) ? y : z;
+  }
+  
+  real_t& operator[](std::size_t i)
+  {
+    BOOST_ASSERT(i < 3);
+    return (i == 0) ? x : (i == 1) ? y : z;
+  }
+  
+  vector3_t operator+(const vector3_t& other) const
+  {return vector3_t(x + other.x, y + other.y, z + other.z);}
+  
+  vector3_t operator-(const vector3_t& other) const
+  {return vector3_t(x - other.x, y - other.y, z - other.z);}
+  
+  vector3_t operator-() const
+  {return vector3_t(-x, -y, -z);}
+  
+  vector3_t operator*(real_t s) const
+  {return vector3_t(x * s, y * s, z * s);}
+  
+  vector3_t operator/(real_t s) const
+  {return vector3_t(x / s, y / s, z / s);}
+  
+  vector3_t& operator+=(const vector3_t& other)
+  {
+    x += other.x; y += other.y; z += other.z;
+    return *this;
+  }
+  
+  vector3_t& operator*=(real_t s)
+  {
+    x *= s; y *= s; z *= s;
+    return *this;
+  }
+  
+  real_t dot(const vector3_t& other) const
+  {return x * other.x + y * other.y + z * other.z;}
+  
+  vector3_t cross(const vector3_t& other) const
+  {
+    return vector3_t(y * other.z - z * other.y,
+                     z * other.x - x * other.z,
+                     x * other.y - y * other.x);
+  }
+  
+  real_t squared_length() const
+  {return dot(*this);}
+  
+  real_t length() const
+  {return std::sqrt(squared_length());}
+  
+  real_t distance(const vector3_t& other) const
+  {return (*this - other).length();}
+  
+  vector3_t normalised() const
+  {
+    real_t l = length();
+    return (l > real_t(0)) ? (*this / l) : *this;
+  }
+  
+  real_t x;
+  real_t y;
+  real_t z;
+};
+
+///Row-major 3x3 matrix; only used for the face rotations, which are orthonormal
+struct matrix3_t
+{
+  matrix3_t()
+  {
+    for (std::size_t r = 0; r < 3; ++r)
+      for (std::size_t c = 0; c < 3; ++c)
+        m[r][c] = (r == c) ? 1 : 0;
+  }
+  
+  matrix3_t(real_t m00, real_t m01, real_t m02,
+            real_t m10, real_t m11, real_t m12,
+            real_t m20, real_t m21, real_t m22)
+  {
+    m[0][0] = m00; m[0][1] = m01; m[0][2] = m02;
+    m[1][0] = m10; m[1][1] = m11; m[1][2] = m12;
+    m[2][0] = m20; m[2][1] = m21; m[2][2] = m22;
+  }
+  
+  vector3_t operator*(const vector3_t& v) const
+  {
+    return vector3_t(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                     m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                     m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+  }
+  
+  matrix3_t transpose() const
+  {
+    return matrix3_t(m[0][0], m[1][0], m[2][0],
+                     m[0][1], m[1][1], m[2][1],
+                     m[0][2], m[1][2], m[2][2]);
+  }
+  
+  real_t m[3][3];
+};
+
+} // namespace planet_core
+
+#endif // PLANET_CORE_TYPES_H
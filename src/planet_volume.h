@@ -31,62 +31,69 @@
 #include <tree/tree.h>
 #include <square/square.h>
 
-#include <boost/multi_index/indexed_by.hpp>
-#include <boost/multi_index/sequenced_index.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/identity.hpp>
-#include <boost/multi_index_container.hpp>
+#include "planet_core/planet.h"
+#include "planet_core/residency.h"
+
+#include <vector>
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/array.hpp>
-#include <boost/ptr_container/ptr_vector.hpp>
 
 namespace cube {
 class direction_t;class face_t;
 }
 
-template<typename planet_renderer_t>
-struct planet_node_t;
-struct texture_freelist_t;
-struct vbuf_freelist_t;
+struct texture_page_allocator_t;
+struct vertex_arena_t;
 
 namespace Ogre {
 class Camera;
 }
 
-struct noise_stack_t;
-
+///Ogre front end of a @c planet_core::planet_t; owns only GPU side state
 struct planet_renderer_t
   : Ogre::MovableObject
+  , planet_core::planet_listener_t
 {
   typedef planet_renderer_t self_t;
   
-  typedef planet_node_t<self_t> planet_node_type;
-  
-  ///Store it as a shared_ptr so it can be copied around cheaply in the tree,
-  /// or copied at all (tree requires values to be copy-constructable and Assignable).
-  typedef boost::shared_ptr< planet_node_type > planet_node_ptr_t;
+  typedef planet_core::planet_t planet_type;
+  typedef planet_core::node_store_t node_store_type;
+  typedef planet_core::node_handle_t node_handle_t;
   
-  typedef tree::root_t<planet_node_ptr_t, 4, square::corner_t> root_type;
-  typedef tree::branch_t<planet_node_ptr_t, 4, square::corner_t> tree_type;
+  typedef planet_type::root_type root_type;
+  typedef planet_type::tree_type tree_type;
   
   
 
   
   
-  planet_renderer_t(Ogre::AxisAlignedBox bounds, Ogre::Real radius, std::size_t max_level);
+  ///@param residency_budget bytes of tile textures and vertex buffers to keep around
+  planet_renderer_t(Ogre::AxisAlignedBox bounds, Ogre::Real radius, std::size_t max_level,
+                    std::size_t residency_budget = 256 * 1024 * 1024);
   virtual ~planet_renderer_t();
   
   ///Regenerate the @c visibles container
   void render_visibles(Ogre::Camera& camera);
   
-  ///Regenerate patches between nodes
+  ///Have each visible tile stitch its edges to coarser neighbors
   void render_transitions();
   
   ///Regenerate the debug frame manual object
   void render_frame(Ogre::Camera& camera);
   
+  ///GPU memory held by tiles: current and peak usage, and the budget
+  const planet_core::residency_manager_t& residency() const;
+  
+  /**
+   * Deepest level drawn for cameras other than @c mcamera, e.g. shadow and
+   * reflection cameras; deeper visibles are drawn as their ancestor at this
+   * level. Unlimited by default.
+   */
+  void set_secondary_max_level(std::size_t level);
+  std::size_t secondary_max_level() const;
+  
 public:
   const Ogre::AxisAlignedBox bounds;
   const Ogre::Real radius;
@@ -112,8 +119,8 @@ public:
   const std::size_t heightmap_width;
   const std::size_t heightmap_height;
   
-  const std::size_t static_index_count;
   const std::size_t vertex_count;
+  const std::size_t static_index_count;
   
   
   Ogre::Camera* mcamera;
@@ -125,74 +132,73 @@ protected:
   virtual const Ogre::String& getMovableType() const;
   virtual void _updateRenderQueue(Ogre::RenderQueue* queue);
   virtual void visitRenderables(Ogre::Renderable::Visitor* visitor, bool debugRenderables = false);
-private:
-  typedef boost::multi_index_container<
-    tree_type*,
-    boost::multi_index::indexed_by<
-      boost::multi_index::sequenced<>, // list-like index
-      boost::multi_index::ordered_unique< boost::multi_index::identity<tree_type*> > // set like
-    >
-  > visibles_t;
-  
-  typedef boost::scoped_ptr<root_type> root_ptr_t;
-  boost::array< root_ptr_t, 6> roots;
-  visibles_t visibles;
+  virtual void _notifyCurrentCamera(Ogre::Camera* camera);
+protected:
+  //planet_listener_t overides
   
-  Ogre::MaterialPtr base_material;
-  Ogre::HardwareIndexBufferSharedPtr ibuf;
+  virtual void tile_generated(node_store_type& nodes, node_handle_t node);
+  virtual void tile_released(node_store_type& nodes, node_handle_t node);
 private:
-  //tree init functions
+  planet_core::residency_manager_t mresidency;
   
-  void initialize_root(tree_type& tree, const cube::face_t& face);
-  void initialize_root_data(tree_type& tree);
-  void initialize_root_data_noise(tree_type& tree);
+  boost::scoped_ptr<planet_type> planet;
   
-  void initialize_tree(tree_type& tree);
+  Ogre::MaterialPtr base_material;
   
-  void initialize_tree_mesh(tree_type& tree);
-  void initialize_tree_data(tree_type& tree);
+  ///Every tile's triangles, one variant per set of edges stitched to coarser neighbors; see planet_core::generate_tile_indices()
+  boost::array<Ogre::HardwareIndexBufferSharedPtr, 16> ibufs;
+  boost::array<std::size_t, 16> index_counts;
+  
+  ///The camera the scene is being rendered for; what gets culled against
+  Ogre::Camera* render_camera;
+  ///Frame the cut was last updated for @c mcamera in; other cameras only cull it
+  unsigned long lod_frame;
+  std::size_t msecondary_max_level;
+  ///Nodes that passed culling, reused across frames
+  std::vector<node_handle_t> culled_visibles;
+private:
+  //tile upload functions
+  
+  void initialize_tree_mesh(node_store_type& nodes, node_handle_t node);
+  void initialize_tree_data(node_store_type& nodes, node_handle_t node);
+  
+  ///Upload the node's tile, and account it in the residency
+  void make_resident(node_store_type& nodes, node_handle_t node);
+  ///Hand the node's GPU resources back to the freelists
+  void release_resources(node_store_type& nodes, node_handle_t node);
+  ///Bytes of GPU resources held by one resident tile
+  std::size_t resident_tile_bytes() const;
+  
+  ///Point the tile's renderable at the index buffer stitched to its coarser neighbors
+  void stitch_edges(const tree_type& tree);
+  ///Set the camera distances over which the tile's renderable morphs into its parent's mesh
+  void set_morph_range(const tree_type& tree, const planet_core::lod_view_t& view);
 private:
   //init functions
   
+  ///Build the index buffer variant stitched along @c coarser_edges
   template<typename index_type>
-  void initialize_index_buffer(Ogre::HardwareIndexBufferSharedPtr& ibuf);
+  void initialize_index_buffer(Ogre::HardwareIndexBufferSharedPtr& ibuf, std::size_t& index_count,
+                               boost::uint8_t coarser_edges);
 private:
-  //utility functions
-  
-  template<typename vector2_t>
-  Ogre::Vector3 to_planet_relative(const cube::face_t& face, const vector2_t& uv) const;
-
-  Ogre::Vector3 to_planet_relative(const cube::face_t& face, const Ogre::Vector2& uv) const;
-private:
-  
-  bool acceptable_pixel_error(const tree_type& tree, const Ogre::Camera& camera) const;
-  
-  Ogre::TexturePtr get_available_noise_texture();
-  Ogre::TexturePtr get_available_diffuse_texture();
-  Ogre::TexturePtr get_available_normals_texture();
-  Ogre::TexturePtr get_available_heightmap_texture();
-  Ogre::HardwareVertexBufferSharedPtr get_available_vertex_buffer(std::size_t vertex_size, std::size_t vertex_count);
-  
-  
-  typedef boost::scoped_ptr< texture_freelist_t > texture_freelist_ptr_t;
-  typedef boost::scoped_ptr< vbuf_freelist_t > vbuf_freelist_ptr_t;
-  
-  texture_freelist_ptr_t noise_texture_freelist;
-  static std::size_t noise_texture_identifier;
-  
-  texture_freelist_ptr_t diffuse_texture_freelist;
-  static std::size_t diffuse_texture_identifier;
   
-  texture_freelist_ptr_t normals_texture_freelist;
-  static std::size_t normals_texture_identifier;
+  typedef boost::scoped_ptr< texture_page_allocator_t > texture_pages_ptr_t;
   
-  texture_freelist_ptr_t heightmap_texture_freelist;
-  static std::size_t heightmap_texture_identifier;
+  ///One texture array allocator per tile channel
+  texture_pages_ptr_t noise_pages;
+  texture_pages_ptr_t diffuse_pages;
+  texture_pages_ptr_t normals_pages;
+  texture_pages_ptr_t heightmap_pages;
   
-  vbuf_freelist_ptr_t heightmap_vbuf_freelist;
+  ///Gives each renderer's pages unique resource names
+  static std::size_t instance_identifier;
   
-  boost::ptr_vector<noise_stack_t> noise_hierarchy;
-  noise_stack_t& get_noise_stack(std::size_t level);
+  ///Slots for every tile's vertices
+  boost::scoped_ptr< vertex_arena_t > vertex_arena;
+  ///Tile vertices are assembled here, then written to their slot in one go
+  std::vector<unsigned char> vertex_staging;
+  ///Each vertex's position on the parent's mesh, while assembling a tile
+  std::vector<planet_core::vector3_t> morph_staging;
 };
 
 
@@ -0,0 +1,137 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "texture_pages.h"
+
+#include <boost/assert.hpp>
+
+#include <OGRE/OgreTextureManager.h>
+#include <OGRE/OgreHardwarePixelBuffer.h>
+#include <OGRE/OgreStringConverter.h>
+
+
+texture_slice_t::texture_slice_t()
+  : page(std::size_t(-1))
+  , layer(std::size_t(-1))
+{
+
+}
+
+texture_slice_t::texture_slice_t(std::size_t page, std::size_t layer)
+  : page(page)
+  , layer(layer)
+{
+
+}
+
+bool texture_slice_t::valid() const
+{
+  return page != std::size_t(-1);
+}
+
+
+texture_page_allocator_t::texture_page_allocator_t(const Ogre::String& name,
+                                                   std::size_t width, std::size_t height, Ogre::PixelFormat format,
+                                                   std::size_t layers_per_page)
+  : name(name)
+  , width(width)
+  , height(height)
+  , format(format)
+  , layers_per_page(layers_per_page)
+{
+  BOOST_ASSERT(layers_per_page > 0);
+}
+
+texture_page_allocator_t::~texture_page_allocator_t()
+{
+  for (std::size_t i = 0; i < pages.size(); ++i)
+  {
+    Ogre::TextureManager::getSingleton().remove(pages[i]->getName());
+  }
+}
+
+void texture_page_allocator_t::add_page()
+{
+  std::size_t index = pages.size();
+  
+  Ogre::String texture_name = name + "-page" + Ogre::StringConverter::toString(index);
+  pages.push_back(Ogre::TextureManager::getSingleton().createManual(texture_name,
+                                                                    Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+                                                                    Ogre::TEX_TYPE_2D_ARRAY,
+                                                                    width, height, layers_per_page,
+                                                                    0,
+                                                                    format,
+                                                                    Ogre::TU_STATIC_WRITE_ONLY));
+  
+  ///Hand out the page front to back
+  for (std::size_t layer = layers_per_page; layer > 0; --layer)
+    free_slices.push_back(texture_slice_t(index, layer - 1));
+}
+
+texture_slice_t texture_page_allocator_t::allocate()
+{
+  if (free_slices.empty())
+    add_page();
+  
+  texture_slice_t slice = free_slices.back();
+  free_slices.pop_back();
+  return slice;
+}
+
+void texture_page_allocator_t::free(const texture_slice_t& slice)
+{
+  BOOST_ASSERT(slice.valid());
+  BOOST_ASSERT(slice.page < pages.size());
+  BOOST_ASSERT(slice.layer < layers_per_page);
+  BOOST_ASSERT(free_slices.size() < pages.size() * layers_per_page);
+  
+  free_slices.push_back(slice);
+}
+
+void texture_page_allocator_t::upload(const texture_slice_t& slice, void* data)
+{
+  BOOST_ASSERT(slice.valid());
+  BOOST_ASSERT(slice.page < pages.size());
+  
+  Ogre::HardwarePixelBufferSharedPtr buffer = pages[slice.page]->getBuffer();
+  buffer->blitFromMemory(Ogre::PixelBox(width, height, 1, format, data),
+                         Ogre::Box(0, 0, slice.layer, width, height, slice.layer + 1));
+}
+
+const Ogre::TexturePtr& texture_page_allocator_t::page(std::size_t index) const
+{
+  BOOST_ASSERT(index < pages.size());
+  return pages[index];
+}
+
+std::size_t texture_page_allocator_t::page_count() const
+{
+  return pages.size();
+}
+
+std::size_t texture_page_allocator_t::used() const
+{
+  return pages.size() * layers_per_page - free_slices.size();
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MORDRED_TEXTURE_PAGES_H
+#define MORDRED_TEXTURE_PAGES_H
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <OGRE/OgreTexture.h>
+#include <OGRE/OgrePixelFormat.h>
+
+///Handle of one layer of a page of a @c texture_page_allocator_t
+struct texture_slice_t
+{
+  ///An invalid slice
+  texture_slice_t();
+  texture_slice_t(std::size_t page, std::size_t layer);
+  
+  bool valid() const;
+  
+  std::size_t page;
+  std::size_t layer;
+};
+
+/**
+ * Hands out fixed size 2D slices of a few large texture arrays ("pages"),
+ * instead of one named texture per tile.
+ * 
+ * Pages are created on demand, @c layers_per_page slices at a time, and
+ * are only ever written to; a slice is recycled as soon as it is freed.
+ */
+struct texture_page_allocator_t
+  : boost::noncopyable
+{
+  ///@param name unique prefix for the pages' resource names
+  texture_page_allocator_t(const Ogre::String& name,
+                           std::size_t width, std::size_t height, Ogre::PixelFormat format,
+                           std::size_t layers_per_page = 64);
+  ///Removes the pages from the texture manager
+  ~texture_page_allocator_t();
+  
+  texture_slice_t allocate();
+  void free(const texture_slice_t& slice);
+  
+  ///Replace the contents of @c slice with @c width * @c height texels of @c format
+  void upload(const texture_slice_t& slice, void* data);
+  
+  const Ogre::TexturePtr& page(std::size_t index) const;
+  std::size_t page_count() const;
+  
+  ///Slices handed out and not freed
+  std::size_t used() const;
+  
+public:
+  const Ogre::String name;
+  const std::size_t width;
+  const std::size_t height;
+  const Ogre::PixelFormat format;
+  const std::size_t layers_per_page;
+private:
+  void add_page();
+  
+  std::vector<Ogre::TexturePtr> pages;
+  std::vector<texture_slice_t> free_slices;
+};
+
+#endif // MORDRED_TEXTURE_PAGES_H
@@ -0,0 +1,362 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+ * Bytes per quadtree node for the @c tree::node_fields_t policies, neighbor
+ * lookup through @c tree::square_adjacency_t's links versus climbing to the
+ * common ancestor, and the links' agreement with the climb after a random
+ * run of splits and joins. Then the stackless traversals versus a walk with
+ * an explicit stack, and their agreement with it.
+ * 
+ * Build with NDEBUG for meaningful timings: the tree's assertions walk
+ * whole broods per call and swamp the figures being compared.
+ * 
+ * Usage: tree_bench [operations] [max level]
+ */
+
+#include <tree/tree.h>
+#include <square/square.h>
+
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace
+{
+  typedef tree::root_t<int, 4, square::corner_t, tree::pool_allocator_t, tree::square_adjacency_t> linked_root_t;
+  typedef linked_root_t::super linked_tree_t;
+  
+  ///The planet's node: a 32 bit handle, only the level stored (see planet_core::planet_t::tree_type)
+  typedef tree::node_fields_t<tree::stored_level_t, tree::climbing_root_t, tree::implicit_corner_t> planet_fields_t;
+  typedef tree::node_fields_t<tree::climbing_level_t, tree::climbing_root_t, tree::implicit_corner_t> derived_fields_t;
+  
+  template<typename adjacency_t, typename fields_t>
+  void report_size(const char* name)
+  {
+    std::cout << name << ": " << sizeof(tree::branch_t<boost::uint32_t, 4, square::corner_t, tree::pool_allocator_t,
+                                                     adjacency_t, fields_t>)
+              << " bytes/node" << std::endl;
+  }
+  
+  double seconds_since(const boost::posix_time::ptime& start)
+  {
+    return double((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds()) / 1e6;
+  }
+  
+  void report(const char* name, std::size_t lookups, double seconds, const char* unit = "lookups")
+  {
+    std::cout << name << ": " << lookups << " " << unit << " in " << seconds << "s, "
+              << (double(lookups) / seconds) << " " << unit << "/s" << std::endl;
+  }
+  
+  ///Pre-order, children pushed last first so they come off the stack in order
+  template<typename tree_type>
+  void stack_pre_order(tree_type& root, std::vector<tree_type*>& stack, std::vector<tree_type*>& nodes)
+  {
+    nodes.clear();
+    stack.assign(1, &root);
+    
+    while (!stack.empty())
+    {
+      tree_type* node = stack.back();
+      stack.pop_back();
+      nodes.push_back(node);
+      
+      if (!node->has_children())
+        continue;
+      
+      for (tree_type* child = boost::end(node->children()); child != boost::begin(node->children()); )
+        stack.push_back(--child);
+    }
+  }
+  
+  ///Reversed, a pre-order that takes the children last to first is the post-order
+  template<typename tree_type>
+  void stack_post_order(tree_type& root, std::vector<tree_type*>& stack, std::vector<tree_type*>& nodes)
+  {
+    nodes.clear();
+    stack.assign(1, &root);
+    
+    while (!stack.empty())
+    {
+      tree_type* node = stack.back();
+      stack.pop_back();
+      nodes.push_back(node);
+      
+      if (!node->has_children())
+        continue;
+      
+      BOOST_FOREACH(tree_type& child, node->children())
+      {
+        stack.push_back(&child);
+      }
+    }
+    
+    std::reverse(nodes.begin(), nodes.end());
+  }
+  
+  template<typename tree_type>
+  void collect(tree_type& root, std::vector<tree_type*>& nodes)
+  {
+    nodes.clear();
+    nodes.push_back(&root);
+    
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+      BOOST_FOREACH(tree_type& child, nodes[i]->children())
+      {
+        nodes.push_back(&child);
+      }
+    }
+  }
+  
+  ///A leaf picked by a random walk down from the root
+  template<typename tree_type>
+  tree_type& random_leaf(tree_type& root)
+  {
+    tree_type* node = &root;
+    
+    while (node->has_children())
+    {
+      node = &node->child(square::corner_t::get(boost::uint8_t(std::rand() % 4)));
+    }
+    
+    return *node;
+  }
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  std::size_t operations = argc > 1 ? std::size_t(std::atol(argv[1])) : 1 << 16;
+  std::size_t max_level = argc > 2 ? std::size_t(std::atol(argv[2])) : 12;
+  
+  report_size<tree::no_adjacency_t, tree::node_fields_t<> >("all fields stored");
+  report_size<tree::no_adjacency_t, planet_fields_t>("planet (level stored)");
+  report_size<tree::no_adjacency_t, derived_fields_t>("all fields derived");
+  report_size<tree::square_adjacency_t, planet_fields_t>("planet, with neighbor links");
+  
+  linked_root_t root;
+  
+  ///Mostly splits of leaves, so the tree grows deep and uneven; the joins undo some of them
+  std::srand(0);
+  for (std::size_t i = 0; i < operations; ++i)
+  {
+    linked_tree_t* node = &random_leaf<linked_tree_t>(root);
+    
+    if (i % 4 != 3)
+    {
+      if (node->level() < max_level)
+        node->split();
+      continue;
+    }
+    
+    if (!node->is_child())
+      continue;
+    
+    linked_tree_t& parent = *node->parent();
+    
+    bool leaves = true;
+    BOOST_FOREACH(const linked_tree_t& child, parent.children())
+    {
+      leaves = leaves && !child.has_children();
+    }
+    
+    if (leaves)
+      parent.join();
+  }
+  
+  std::vector<linked_tree_t*> nodes;
+  collect<linked_tree_t>(root, nodes);
+  
+  std::size_t mismatches = 0;
+  BOOST_FOREACH(const linked_tree_t* node, nodes)
+  {
+    BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+    {
+      if (node->adjacent(direction) != node->find_adjacent(direction))
+        ++mismatches;
+    }
+  }
+  
+  std::cout << nodes.size() << " nodes, " << mismatches << " mismatched links" << std::endl;
+  
+  ///Enough passes over the nodes to time
+  std::size_t passes = std::max<std::size_t>(1, (std::size_t(1) << 24) / (nodes.size() * square::direction_t::SIZE));
+  std::size_t lookups = passes * nodes.size() * square::direction_t::SIZE;
+  std::size_t found = 0;
+  
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t pass = 0; pass < passes; ++pass)
+  {
+    BOOST_FOREACH(const linked_tree_t* node, nodes)
+    {
+      BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+      {
+        found += node->adjacent(direction) ? 1 : 0;
+      }
+    }
+  }
+  report("links", lookups, seconds_since(start));
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t pass = 0; pass < passes; ++pass)
+  {
+    BOOST_FOREACH(const linked_tree_t* node, nodes)
+    {
+      BOOST_FOREACH(const square::direction_t& direction, square::direction_t::all())
+      {
+        found -= node->find_adjacent(direction) ? 1 : 0;
+      }
+    }
+  }
+  report("climbing", lookups, seconds_since(start));
+  
+  ///Every traversal against the explicit stack's pre-order
+  std::vector<linked_tree_t*> stack;
+  std::vector<linked_tree_t*> expected;
+  stack_pre_order<linked_tree_t>(root, stack, expected);
+  
+  std::size_t traversal_mismatches = 0;
+  std::size_t max_depth = 0;
+  {
+    std::size_t i = 0;
+    BOOST_FOREACH(linked_tree_t& node, root.pre_order_traversal())
+    {
+      traversal_mismatches += (i >= expected.size() || &node != expected[i]) ? 1 : 0;
+      max_depth = std::max(max_depth, node.level());
+      ++i;
+    }
+    traversal_mismatches += i != expected.size() ? 1 : 0;
+    
+    ///Leaves, and each level, are the pre-order's in the same order
+    std::vector<linked_tree_t*> leaves;
+    BOOST_FOREACH(linked_tree_t* node, expected)
+    {
+      if (!node->has_children())
+        leaves.push_back(node);
+    }
+    
+    i = 0;
+    BOOST_FOREACH(linked_tree_t& leaf, root.leaf_traversal())
+    {
+      traversal_mismatches += (i >= leaves.size() || &leaf != leaves[i]) ? 1 : 0;
+      ++i;
+    }
+    traversal_mismatches += i != leaves.size() ? 1 : 0;
+    
+    for (std::size_t level = 0; level <= max_depth + 1; ++level)
+    {
+      std::vector<linked_tree_t*>::const_iterator next = expected.begin();
+      
+      BOOST_FOREACH(linked_tree_t& node, root.level_traversal(level))
+      {
+        while (next != expected.end() && (*next)->level() != level)
+          ++next;
+        
+        traversal_mismatches += (next == expected.end() || &node != *next) ? 1 : 0;
+        if (next != expected.end())
+          ++next;
+      }
+      
+      while (next != expected.end() && (*next)->level() != level)
+        ++next;
+      traversal_mismatches += next != expected.end() ? 1 : 0;
+    }
+    
+    std::vector<linked_tree_t*> post_order;
+    stack_post_order<linked_tree_t>(root, stack, post_order);
+    
+    i = 0;
+    BOOST_FOREACH(linked_tree_t& node, root.post_order_traversal())
+    {
+      traversal_mismatches += (i >= post_order.size() || &node != post_order[i]) ? 1 : 0;
+      ++i;
+    }
+    traversal_mismatches += i != post_order.size() ? 1 : 0;
+  }
+  
+  std::cout << expected.size() << " nodes traversed, " << traversal_mismatches << " mismatched traversals" << std::endl;
+  
+  passes = std::max<std::size_t>(1, (std::size_t(1) << 24) / expected.size());
+  std::size_t visits = passes * expected.size();
+  std::size_t sum = 0;
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t pass = 0; pass < passes; ++pass)
+  {
+    stack.assign(1, &root);
+    
+    while (!stack.empty())
+    {
+      linked_tree_t* node = stack.back();
+      stack.pop_back();
+      sum += node->value();
+      
+      BOOST_FOREACH(linked_tree_t& child, node->children())
+      {
+        stack.push_back(&child);
+      }
+    }
+  }
+  report("stack walk", visits, seconds_since(start), "visits");
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t pass = 0; pass < passes; ++pass)
+  {
+    BOOST_FOREACH(const linked_tree_t& node, root.pre_order_traversal())
+    {
+      sum -= node.value();
+    }
+  }
+  report("pre-order", visits, seconds_since(start), "visits");
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t pass = 0; pass < passes; ++pass)
+  {
+    BOOST_FOREACH(const linked_tree_t& node, root.post_order_traversal())
+    {
+      sum += node.value();
+    }
+  }
+  report("post-order", visits, seconds_since(start), "visits");
+  
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (std::size_t pass = 0; pass < passes; ++pass)
+  {
+    BOOST_FOREACH(const linked_tree_t& node, root.leaf_traversal())
+    {
+      sum -= node.value();
+    }
+  }
+  report("leaves", passes * (expected.size() - (expected.size() - 1) / 4), seconds_since(start), "visits");
+  
+  std::cout << "(checksum " << sum << ")" << std::endl;
+  
+  return (mismatches == 0 && found == 0 && traversal_mismatches == 0) ? 0 : 1;
+}
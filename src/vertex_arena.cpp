@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "vertex_arena.h"
+
+#include <boost/assert.hpp>
+
+#include <OGRE/OgreHardwareBufferManager.h>
+
+
+vertex_slot_t::vertex_slot_t()
+  : buffer(std::size_t(-1))
+  , slot(std::size_t(-1))
+{
+
+}
+
+vertex_slot_t::vertex_slot_t(std::size_t buffer, std::size_t slot)
+  : buffer(buffer)
+  , slot(slot)
+{
+
+}
+
+bool vertex_slot_t::valid() const
+{
+  return buffer != std::size_t(-1);
+}
+
+
+vertex_arena_t::vertex_arena_t(std::size_t vertex_size, std::size_t slot_vertices, std::size_t slots_per_buffer)
+  : vertex_size(vertex_size)
+  , slot_vertices(slot_vertices)
+  , slots_per_buffer(slots_per_buffer)
+  , mused(0)
+{
+  BOOST_ASSERT(vertex_size > 0);
+  BOOST_ASSERT(slot_vertices > 0);
+  BOOST_ASSERT(slots_per_buffer > 0);
+}
+
+void vertex_arena_t::add_buffer()
+{
+  using namespace Ogre;
+  
+  buffers.push_back(HardwareBufferManager::getSingleton().createVertexBuffer(
+    vertex_size,
+    slot_vertices * slots_per_buffer,
+    HardwareBuffer::HBU_STATIC_WRITE_ONLY));
+  
+  free_slots.push_back(boost::dynamic_bitset<>(slots_per_buffer));
+  free_slots.back().set();
+}
+
+vertex_slot_t vertex_arena_t::allocate()
+{
+  for (std::size_t buffer = 0; buffer < free_slots.size(); ++buffer)
+  {
+    std::size_t slot = free_slots[buffer].find_first();
+    
+    if (slot != boost::dynamic_bitset<>::npos)
+    {
+      free_slots[buffer].reset(slot);
+      ++mused;
+      return vertex_slot_t(buffer, slot);
+    }
+  }
+  
+  add_buffer();
+  
+  free_slots.back().reset(0);
+  ++mused;
+  return vertex_slot_t(buffers.size() - 1, 0);
+}
+
+void vertex_arena_t::free(const vertex_slot_t& slot)
+{
+  BOOST_ASSERT(slot.valid());
+  BOOST_ASSERT(slot.buffer < buffers.size());
+  BOOST_ASSERT(slot.slot < slots_per_buffer);
+  BOOST_ASSERT(!free_slots[slot.buffer].test(slot.slot));
+  
+  free_slots[slot.buffer].set(slot.slot);
+  --mused;
+}
+
+void vertex_arena_t::upload(const vertex_slot_t& slot, const void* data)
+{
+  BOOST_ASSERT(slot.valid());
+  BOOST_ASSERT(!free_slots[slot.buffer].test(slot.slot));
+  
+  std::size_t slot_bytes = slot_vertices * vertex_size;
+  
+  ///Only this slot's range is written; the rest of the buffer may be in flight
+  buffers[slot.buffer]->writeData(slot.slot * slot_bytes, slot_bytes, data, false);
+}
+
+const Ogre::HardwareVertexBufferSharedPtr& vertex_arena_t::buffer(const vertex_slot_t& slot) const
+{
+  BOOST_ASSERT(slot.valid());
+  BOOST_ASSERT(slot.buffer < buffers.size());
+  return buffers[slot.buffer];
+}
+
+std::size_t vertex_arena_t::vertex_start(const vertex_slot_t& slot) const
+{
+  BOOST_ASSERT(slot.valid());
+  return slot.slot * slot_vertices;
+}
+
+std::size_t vertex_arena_t::buffer_count() const
+{
+  return buffers.size();
+}
+
+std::size_t vertex_arena_t::used() const
+{
+  return mused;
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2012 <copyright holder> <email>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MORDRED_VERTEX_ARENA_H
+#define MORDRED_VERTEX_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/dynamic_bitset.hpp>
+
+#include <OGRE/OgreHardwareVertexBuffer.h>
+
+///Handle of one tile sized slot of a @c vertex_arena_t
+struct vertex_slot_t
+{
+  ///An invalid slot
+  vertex_slot_t();
+  vertex_slot_t(std::size_t buffer, std::size_t slot);
+  
+  bool valid() const;
+  
+  std::size_t buffer;
+  std::size_t slot;
+};
+
+/**
+ * A few large vertex buffers, divided into slots of @c slot_vertices vertices.
+ * 
+ * Tiles draw from their slot through @c VertexData::vertexStart, so they can
+ * share the index buffer and the vertex buffer binding. Free slots are tracked
+ * in one bitmap per buffer; buffers are added as the arena fills up.
+ */
+struct vertex_arena_t
+  : boost::noncopyable
+{
+  vertex_arena_t(std::size_t vertex_size, std::size_t slot_vertices, std::size_t slots_per_buffer = 256);
+  
+  vertex_slot_t allocate();
+  void free(const vertex_slot_t& slot);
+  
+  ///Replace the contents of @c slot with @c slot_vertices vertices of @c vertex_size bytes
+  void upload(const vertex_slot_t& slot, const void* data);
+  
+  const Ogre::HardwareVertexBufferSharedPtr& buffer(const vertex_slot_t& slot) const;
+  ///The first vertex of @c slot in its buffer, for @c VertexData::vertexStart
+  std::size_t vertex_start(const vertex_slot_t& slot) const;
+  
+  std::size_t buffer_count() const;
+  ///Slots handed out and not freed
+  std::size_t used() const;
+  
+public:
+  const std::size_t vertex_size;
+  const std::size_t slot_vertices;
+  const std::size_t slots_per_buffer;
+private:
+  void add_buffer();
+  
+  std::vector<Ogre::HardwareVertexBufferSharedPtr> buffers;
+  ///A set bit is a free slot
+  std::vector< boost::dynamic_bitset<> > free_slots;
+  std::size_t mused;
+};
+
+#endif // MORDRED_VERTEX_ARENA_H